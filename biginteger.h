@@ -1,29 +1,395 @@
+#pragma once
+
 #include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <iostream>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <type_traits>
 #include <vector>
 #include <string>
 
+#include "hash.h"
+
+// AVX2 add/sub/compare kernels, selected at run time; -DBIGINTEGER_NO_SIMD keeps the scalar ones.
+#if !defined(BIGINTEGER_NO_SIMD) && defined(__x86_64__) && defined(__GNUC__)
+#define BIGINTEGER_AVX2_KERNELS
+#include <immintrin.h>
+#endif
+
+// Vector of trivially copyable elements that keeps up to N of them inline and only
+// moves to the heap when it grows past that.
+template <typename T, size_t N>
+class SmallVector {
+private:
+    static_assert(std::is_trivially_copyable<T>::value, "SmallVector stores raw bytes");
+
+    T* data_;
+    size_t size_ = 0;
+    size_t capacity_ = N;
+    T inline_[N];
+
+    bool isInline() const { return data_ == inline_; }
+
+    void grow(size_t n) {
+        size_t capacity = std::max(n, 2 * capacity_);
+        T* heap = new T[capacity];
+        std::memcpy(heap, data_, size_ * sizeof(T));
+        if (!isInline()) {
+            delete[] data_;
+        }
+        data_ = heap;
+        capacity_ = capacity;
+    }
+
+public:
+    SmallVector() : data_(inline_) {}
+
+    SmallVector(size_t n, const T& value) : data_(inline_) {
+        assign(n, value);
+    }
+
+    SmallVector(const SmallVector& other) : data_(inline_) {
+        assign(other.begin(), other.end());
+    }
+
+    SmallVector(SmallVector&& other) noexcept : data_(inline_) {
+        swap(other);
+    }
+
+    ~SmallVector() {
+        if (!isInline()) {
+            delete[] data_;
+        }
+    }
+
+    SmallVector& operator=(const SmallVector& other) {
+        if (this != &other) {
+            assign(other.begin(), other.end());
+        }
+        return *this;
+    }
+
+    SmallVector& operator=(SmallVector&& other) noexcept {
+        if (this != &other) {
+            swap(other);
+        }
+        return *this;
+    }
+
+    void swap(SmallVector& other) noexcept {
+        if (!isInline() && !other.isInline()) {
+            std::swap(data_, other.data_);
+        } else if (isInline() && other.isInline()) {
+            T buffer[N];
+            std::memcpy(buffer, inline_, size_ * sizeof(T));
+            std::memcpy(inline_, other.inline_, other.size_ * sizeof(T));
+            std::memcpy(other.inline_, buffer, size_ * sizeof(T));
+        } else {
+            SmallVector& small = isInline() ? *this : other;
+            SmallVector& large = isInline() ? other : *this;
+            std::memcpy(large.inline_, small.inline_, small.size_ * sizeof(T));
+            small.data_ = large.data_;
+            large.data_ = large.inline_;
+        }
+        std::swap(size_, other.size_);
+        std::swap(capacity_, other.capacity_);
+    }
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    bool empty() const { return size_ == 0; }
+
+    T* data() { return data_; }
+    const T* data() const { return data_; }
+    T* begin() { return data_; }
+    const T* begin() const { return data_; }
+    T* end() { return data_ + size_; }
+    const T* end() const { return data_ + size_; }
+
+    T& operator[](size_t index) { return data_[index]; }
+    const T& operator[](size_t index) const { return data_[index]; }
+    T& back() { return data_[size_ - 1]; }
+    const T& back() const { return data_[size_ - 1]; }
+
+    void reserve(size_t n) {
+        if (n > capacity_) {
+            grow(n);
+        }
+    }
+
+    void resize(size_t n, const T& value = T()) {
+        reserve(n);
+        std::fill(data_ + std::min(n, size_), data_ + n, value);
+        size_ = n;
+    }
+
+    void assign(size_t n, const T& value) {
+        size_ = 0;
+        resize(n, value);
+    }
+
+    void assign(const T* first, const T* last) {
+        size_t n = last - first;
+        reserve(n);
+        std::memmove(data_, first, n * sizeof(T));
+        size_ = n;
+    }
+
+    void push_back(const T& value) {
+        if (size_ == capacity_) {
+            T copy = value;
+            grow(size_ + 1);
+            data_[size_++] = copy;
+        } else {
+            data_[size_++] = value;
+        }
+    }
+
+    void pop_back() { --size_; }
+    void clear() { size_ = 0; }
+};
+
+template <typename Derived>
+class BigIntegerExpression;
+
+class BigIntegerView;
+class Matrix;
+
+template <size_t Bits>
+class FixedInt;
+
 class BigInteger {
 private:
-    static const int kBase_ = 1000000000;
+// -DBIGINTEGER_BINARY_LIMBS switches to 2^64 limbs; decimal digits then only appear in
+// toString/toChars/fromChars, which convert in base 10^19 chunks.
+#ifdef BIGINTEGER_BINARY_LIMBS
+    using Limb = unsigned long long;
+    using DoubleLimb = unsigned __int128;
+    using SignedDoubleLimb = __int128;
+    static const bool kBinaryLimbs_ = true;
+    static constexpr DoubleLimb kBase_ = DoubleLimb(1) << 64;
+    static const int kDigitLength_ = 19;
+    static constexpr Limb kDecimalChunk_ = 10000000000000000000ull;
+    static const size_t kKaratsubaThreshold_ = 24;
+    static const size_t kToom3Threshold_ = 120;
+    static const size_t kNttThreshold_ = 700;
+    static const size_t kNttChunksPerLimb_ = 2;
+    static const unsigned long long kNttChunkBase_ = 1ull << 32;
+    static const size_t kInlineLimbs_ = 2;
+    static const long long kLehmerCofactorBound_ = 1ll << 62;
+#else
+    using Limb = int;
+    using DoubleLimb = long long;
+    using SignedDoubleLimb = long long;
+    static const bool kBinaryLimbs_ = false;
+    static constexpr DoubleLimb kBase_ = 1000000000;
     static const int kDigitLength_ = 9;
+    static constexpr Limb kDecimalChunk_ = 1000000000;
+    static const size_t kKaratsubaThreshold_ = 32;
+    static const size_t kToom3Threshold_ = 160;
+    static const size_t kNttThreshold_ = 1500;
+    static const size_t kNttChunksPerLimb_ = 1;
+    static const unsigned long long kNttChunkBase_ = 1000000000;
+    static const size_t kInlineLimbs_ = 5;
+    static const long long kLehmerCofactorBound_ = 1ll << 31;
+#endif
+    static const size_t kRadixThreshold_ = 40;
+    static const size_t kNttMaxLength_ = size_t(1) << 23;
+    static const size_t kStackProductLimbs_ = 2 * kKaratsubaThreshold_;
+    static const unsigned kNttPrime1_ = 998244353;
+    static const unsigned kNttPrime2_ = 167772161;
+    static const unsigned kNttPrime3_ = 469762049;
+    static const size_t kBurnikelZieglerThreshold_ = 60;
+    static const size_t kSimdThreshold_ = 8;
+    static const size_t kHalfGcdThreshold_ = 160;
+    static const size_t kQuotientLimbs_ = 4;
+    static const size_t kParallelLimbs_ = 256;
+    static const size_t kWordBaseLevel_ = 4;
+    static const size_t kSmallShiftBits_ = 4 * 29;
+    static const unsigned long long kSquareFilterModulus_ = 3ull * 5 * 7 * 11 * 13 * 17 * 19 * 23;
 
-    std::vector<int> digits_;
+    using LimbVector = SmallVector<Limb, kInlineLimbs_>;
+
+    LimbVector digits_;
     bool is_negative_ = false;
 
+    static size_t trimLimbs(const Limb* a, size_t n);
+    static int compareLimbs(const Limb* a, size_t n, const Limb* b, size_t m);
+    static Limb addLimbs(Limb* a, size_t n, const Limb* b, size_t m);
+    static Limb subLimbs(Limb* a, size_t n, const Limb* b, size_t m);
+    static Limb reverseSubLimbs(Limb* a, const Limb* b, size_t n);
+#ifdef BIGINTEGER_AVX2_KERNELS
+    static bool hasAvx2();
+    static size_t addLimbsAvx2(Limb* a, const Limb* b, size_t m, Limb& carry);
+    static size_t subLimbsAvx2(Limb* out, const Limb* a, const Limb* b, size_t m, Limb& borrow);
+    static size_t mismatchLimbsAvx2(const Limb* a, const Limb* b, size_t n);
+#endif
+    static Limb mulSmallLimbs(Limb* a, size_t n, Limb factor);
+    static Limb divSmallLimbs(Limb* a, size_t n, Limb divisor);
+
+    static void mulSchoolbook(const Limb* a, size_t n, const Limb* b, size_t m, Limb* out);
+    static void mulUnbalanced(const Limb* a, size_t n, const Limb* b, size_t m, Limb* out);
+    static void mulKaratsuba(const Limb* a, size_t n, const Limb* b, size_t m, Limb* out);
+    static void mulToom3(const Limb* a, size_t n, const Limb* b, size_t m, Limb* out);
+    template <unsigned Mod>
+    static unsigned nttPow(unsigned long long base, unsigned long long exp);
+    template <unsigned Mod>
+    static void ntt(std::vector<unsigned>& a);
+    static void splitNttChunks(const Limb* a, size_t n, std::vector<unsigned>& chunks);
+    template <unsigned Mod>
+    static void nttConvolution(const std::vector<unsigned>& a, const std::vector<unsigned>& b,
+                               size_t size, std::vector<unsigned>& out);
+    static void mulNtt(const Limb* a, size_t n, const Limb* b, size_t m, Limb* out);
+    static void mulLimbs(const Limb* a, size_t n, const Limb* b, size_t m, Limb* out);
+
+    // One runParallel call: tasks not yet claimed start at next (task 0 is the caller's), and
+    // done counts finished ones. error keeps the first exception a task threw.
+    struct Fork {
+        std::function<void()>* tasks;
+        size_t count;
+        std::atomic<size_t> next{1};
+        size_t done = 0;
+        std::exception_ptr error = nullptr;
+    };
+    // Persistent workers shared by all multiplications. limit counts the threads that may
+    // work at once, the calling thread included; workers are started as the limit asks for
+    // them and kept until exit. forks queues the calls that still have unclaimed tasks.
+    struct ThreadPool {
+        std::atomic<unsigned> limit{std::max(1u, std::thread::hardware_concurrency())};
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable finished;
+        std::deque<Fork*> forks;
+        std::vector<std::thread> workers;
+        bool stopping = false;
+
+        ~ThreadPool();
+    };
+    static ThreadPool& threadPool();
+    static void runTask(Fork& fork, size_t index);
+    static void workerLoop(size_t index);
+    static void runParallel(std::function<void()>* tasks, size_t count);
+    template <typename... Tasks>
+    static void forkJoin(bool parallel, Tasks&&... tasks);
+    static void productRange(BigInteger* values, const size_t* limbs, size_t first, size_t last,
+                             BigInteger& result);
+
+    static void divKnuth(const Limb* u, size_t un, const Limb* v, size_t vn,
+                         std::vector<Limb>& quotient, std::vector<Limb>& remainder);
+    static void div2n1n(const Limb* a, const Limb* b, size_t n,
+                        std::vector<Limb>& quotient, std::vector<Limb>& remainder);
+    static void div3n2n(const Limb* a, const Limb* b, size_t half,
+                        std::vector<Limb>& quotient, std::vector<Limb>& remainder);
+    static void divBurnikelZiegler(const Limb* u, size_t un, const Limb* v, size_t vn,
+                                   std::vector<Limb>& quotient, std::vector<Limb>& remainder);
+    static void divmodLimbs(const Limb* u, size_t un, const Limb* v, size_t vn,
+                            std::vector<Limb>& quotient, std::vector<Limb>& remainder);
+
+    static void limbsToDecimal(const Limb* a, size_t n, const std::vector<std::vector<Limb>>& powers,
+                               size_t width, std::vector<Limb>& chunks);
+    static void decimalToLimbs(const Limb* chunks, size_t n, const std::vector<std::vector<Limb>>& powers,
+                               std::vector<Limb>& limbs);
+    static void decimalPowers(size_t chunks, std::vector<std::vector<Limb>>& powers);
+    size_t decimalChunks(std::vector<Limb>& storage, const Limb*& chunks) const;
+    static size_t decimalLength(const Limb* chunks, size_t n, bool negative);
+    static void writeDecimal(const Limb* chunks, size_t n, bool negative, char* end);
+
+    static bool toSmall(const Limb* a, size_t n, unsigned __int128& value);
+    void assignSmall(unsigned __int128 value, bool negative);
+    void assignLimbs(const Limb* limbs, size_t n, bool negative);
+    void assignProduct(const BigInteger& a, const BigInteger& b);
+    void negate();
+
+    // a / b for positive a and b, correctly rounded to nearest-even in Float.
+    static int bitLength(unsigned __int128 value);
+    static long long bitLengthEstimate(const BigInteger& value);
+    static BigInteger powerOfTwo(size_t exponent);
+    template <typename Float>
+    static Float roundScaled(unsigned __int128 q, long long shift, bool sticky);
+    template <typename Float>
+    static Float roundQuotientExact(const BigInteger& a, const BigInteger& b);
+    template <typename Float>
+    static Float roundQuotient(const BigInteger& a, const BigInteger& b);
+
+    // GCD reductions keep a >= b >= 0; cofactors, when given, is the row-major 2x2 matrix R
+    // with (a, b) = R (a0, b0) for the starting values and is updated with every step.
+    static void combineLimbs(Limb* out, const Limb* a, Limb u, const Limb* b, Limb v, size_t n);
+    static unsigned __int128 binaryGcd(unsigned __int128 a, unsigned __int128 b);
+    static void divisionStep(BigInteger& a, BigInteger& b, BigInteger* cofactors);
+    static void lehmerStep(BigInteger& a, BigInteger& b, BigInteger* cofactors, LimbVector* scratch);
+    static void halfGcd(BigInteger& a, BigInteger& b, size_t s, BigInteger* cofactors,
+                        LimbVector* scratch);
+    static void reduceGcd(BigInteger& a, BigInteger& b, BigInteger* cofactors);
+
+    static unsigned __int128 isqrtSmall(unsigned __int128 value);
+    static BigInteger rootNewton(const BigInteger& value, unsigned k);
+    static unsigned long long remainderSmall(const Limb* a, size_t n, unsigned long long modulus);
+    static constexpr unsigned long long squareResidues(unsigned modulus);
+
+    // Bit view of the magnitude in 64-bit words, least significant first. Binary limbs are
+    // the words; decimal limbs convert by divide and conquer over powers[k] = 2^(64 2^k).
+    using Word = unsigned long long;
+    static void wordPowers(size_t levels, std::vector<BigInteger>& powers);
+    static void decimalToWords(const BigInteger& value, const std::vector<BigInteger>& powers, size_t level,
+                               Word* out);
+    static BigInteger wordsToDecimal(const Word* words, const std::vector<BigInteger>& powers, size_t level);
+    void toWords(std::vector<Word>& words) const;
+    void assignWords(const Word* words, size_t n, bool negative);
+    BigInteger& bitwiseAssign(const BigInteger& other, char op);
+
+    // Binary format: an 8-byte header (version, flags, two reserved bytes, 32-bit limb count in
+    // the writer's byte order) followed by the raw limbs, zero-padded to a multiple of 8 bytes
+    // so that consecutive values stay aligned.
+    static const unsigned char kSerialVersion_ = 1;
+    static const unsigned char kSerialNegative_ = 1;
+    static const unsigned char kSerialBinaryLimbs_ = 2;
+    static const unsigned char kSerialBigEndian_ = 4;
+    static const unsigned char kSerialBatch_ = 8;
+    static const size_t kSerialHeader_ = 8;
+    static const size_t kSerialMaxCount_ = 0xFFFFFFFFu;
+    static bool hostBigEndian();
+    static void writeSerialHeader(char* out, unsigned char flags, size_t count);
+    static bool readSerialHeader(const char* in, unsigned char& flags, size_t& count);
+    static BigInteger fromDecimalLimbs(const unsigned* limbs, size_t n);
+
 public:
     BigInteger();
     BigInteger(long long value);
-    BigInteger(std::string& str);
+    BigInteger(const std::string& str);
+    template <typename Expression>
+    BigInteger(const BigIntegerExpression<Expression>& expression);
 
     void makeUnsigned();
     void popZeros();
     void addPositive(const BigInteger& other);
-    void subtractPositive(BigInteger other);
+    void subtractPositive(const BigInteger& other);
     std::string toString() const;
-    const std::vector<int>& data() const;
+    size_t decimalLength() const;
+    std::to_chars_result toChars(char* first, char* last) const;
+    std::from_chars_result fromChars(const char* first, const char* last);
+    static void setThreadLimit(unsigned threads);
+    size_t serializedSize() const;
+    std::to_chars_result serialize(char* first, char* last) const;
+    std::from_chars_result deserialize(const char* first, const char* last);
+    const LimbVector& data() const;
     bool is_negative() const;
+    size_t hash() const;
+    void reserve(size_t limbs);
 
+    template <typename Expression>
+    BigInteger& operator=(const BigIntegerExpression<Expression>& expression);
     BigInteger& operator+=(const BigInteger& other);
     BigInteger& operator-=(const BigInteger& other);
     BigInteger& operator*=(const BigInteger& other);
@@ -34,14 +400,59 @@ public:
     BigInteger operator++(int);
     BigInteger& operator--();
     BigInteger operator--(int);
-    BigInteger operator-() const;
+    BigInteger operator-() const&;
+    BigInteger operator-() &&;
+
+    BigInteger& operator<<=(size_t shift);
+    BigInteger& operator>>=(size_t shift);
+    BigInteger& operator&=(const BigInteger& other);
+    BigInteger& operator|=(const BigInteger& other);
+    BigInteger& operator^=(const BigInteger& other);
+    BigInteger operator~() const;
+
+    size_t bit_length() const;
+    bool test_bit(size_t index) const;
+    size_t popcount() const;
 
     explicit operator int() const;
     explicit operator bool() const;
+    explicit operator double() const;
+    explicit operator long double() const;
 
     friend std::istream& operator>>(std::istream& istream, BigInteger& number);
+    friend void divmod(const BigInteger& dividend, const BigInteger& divisor,
+                       BigInteger& quotient, BigInteger& remainder);
+    friend void swap(BigInteger& first, BigInteger& second);
+    friend bool operator<(const BigInteger& a, const BigInteger& b);
+    friend bool operator==(const BigInteger& a, const BigInteger& b);
+    friend BigInteger operator*(const BigInteger& left, const BigInteger& other);
+    template <char Op, typename Left, typename Right>
+    friend class BigIntegerBinaryExpression;
+    friend class BigIntegerModulus;
+    friend class BigIntegerView;
+    template <size_t Bits>
+    friend class FixedInt;
+    friend class Matrix;
+    friend class Rational;
+    friend BigInteger GCD(const BigInteger& first, const BigInteger& second);
+    friend BigInteger extendedGCD(const BigInteger& first, const BigInteger& second,
+                                  BigInteger& x, BigInteger& y);
+    friend BigInteger isqrt(const BigInteger& value);
+    friend BigInteger iroot(const BigInteger& value, unsigned k);
+    friend bool is_perfect_square(const BigInteger& value);
+    template <typename Iterator>
+    friend BigInteger product(Iterator first, Iterator last);
+    template <typename T>
+    friend size_t serializedSize(const std::vector<T>& values);
+    template <typename T>
+    friend std::to_chars_result serializeBatch(const std::vector<T>& values, char* first, char* last);
+    template <typename T>
+    friend std::from_chars_result deserializeBatch(const char* first, const char* last, std::vector<T>& values);
 };
 
+void divmod(const BigInteger& dividend, const BigInteger& divisor,
+            BigInteger& quotient, BigInteger& remainder);
+
 void swap(BigInteger& first, BigInteger& second);
 
 BigInteger operator""_bi(const char* string, size_t);
@@ -55,43 +466,64 @@ bool operator==(const BigInteger& a, const BigInteger& b);
 bool operator!=(const BigInteger& a, const BigInteger& b);
 
 BigInteger operator+(const BigInteger& left, const BigInteger& other);
+BigInteger operator+(BigInteger&& left, const BigInteger& other);
+BigInteger operator+(const BigInteger& left, BigInteger&& other);
+BigInteger operator+(BigInteger&& left, BigInteger&& other);
 BigInteger operator-(const BigInteger& left, const BigInteger& other);
+BigInteger operator-(BigInteger&& left, const BigInteger& other);
+BigInteger operator-(const BigInteger& left, BigInteger&& other);
+BigInteger operator-(BigInteger&& left, BigInteger&& other);
 BigInteger operator*(const BigInteger& left, const BigInteger& other);
+BigInteger operator*(BigInteger&& left, const BigInteger& other);
+BigInteger operator*(const BigInteger& left, BigInteger&& other);
+BigInteger operator*(BigInteger&& left, BigInteger&& other);
 BigInteger operator/(const BigInteger& left, const BigInteger& other);
+BigInteger operator/(BigInteger&& left, const BigInteger& other);
 BigInteger operator%(const BigInteger& left, const BigInteger& other);
+BigInteger operator%(BigInteger&& left, const BigInteger& other);
+BigInteger operator<<(const BigInteger& left, size_t shift);
+BigInteger operator<<(BigInteger&& left, size_t shift);
+BigInteger operator>>(const BigInteger& left, size_t shift);
+BigInteger operator>>(BigInteger&& left, size_t shift);
+BigInteger operator&(const BigInteger& left, const BigInteger& other);
+BigInteger operator&(BigInteger&& left, const BigInteger& other);
+BigInteger operator|(const BigInteger& left, const BigInteger& other);
+BigInteger operator|(BigInteger&& left, const BigInteger& other);
+BigInteger operator^(const BigInteger& left, const BigInteger& other);
+BigInteger operator^(BigInteger&& left, const BigInteger& other);
+
+BigInteger GCD(const BigInteger& first, const BigInteger& second);
+BigInteger extendedGCD(const BigInteger& first, const BigInteger& second,
+                       BigInteger& x, BigInteger& y);
+
+BigInteger isqrt(const BigInteger& value);
+BigInteger iroot(const BigInteger& value, unsigned k);
+bool is_perfect_square(const BigInteger& value);
 
 std::ostream& operator<<(std::ostream& ostream, const BigInteger& number);
 
+template <>
+struct std::hash<BigInteger> {
+    size_t operator()(const BigInteger& value) const { return value.hash(); }
+};
 
-BigInteger::BigInteger() {}
+BigInteger::BigInteger() : digits_(1, 0) {}
 
 BigInteger::BigInteger(long long value) {
     is_negative_ = bool(value < 0);
-    value = (value < 0) ? -value : value;
-    if (value == 0) { digits_ = {0}; }
-    while (value > 0) {
-        digits_.push_back(value % kBase_);
-        value /= kBase_;
+    unsigned long long magnitude = static_cast<unsigned long long>(value);
+    magnitude = (value < 0) ? 0 - magnitude : magnitude;
+    if (magnitude == 0) { digits_.push_back(0); }
+    while (magnitude > 0) {
+        digits_.push_back(static_cast<Limb>(magnitude % kBase_));
+        magnitude /= kBase_;
     }
 }
 
-BigInteger::BigInteger(std::string& str) {
-    if (str[0] == '-') {
-        is_negative_ = true;
-        str.erase(str.begin());
-    }
-    std::string support;
-    for (int i = static_cast<int>(str.length()) - 1; i >= 0; --i) {
-        if (support.length() == kDigitLength_) {
-            std::reverse(support.begin(), support.end());
-            digits_.push_back(std::stoi(support));
-            support.clear();
-        }
-        support += str[i];
-    }
-    if (!support.empty()) {
-        std::reverse(support.begin(), support.end());
-        digits_.push_back(std::stoi(support));
+BigInteger::BigInteger(const std::string& str) {
+    std::from_chars_result result = fromChars(str.data(), str.data() + str.size());
+    if (result.ec != std::errc()) {
+        throw std::invalid_argument("BigInteger: no digits in \"" + str + "\"");
     }
 }
 
@@ -104,11 +536,158 @@ BigInteger::operator bool() const {
     return (*this == 1);
 }
 
+BigInteger::operator double() const {
+    if (digits_.size() == 1 && digits_[0] == 0) {
+        return 0;
+    }
+    double value = roundQuotient<double>(*this, BigInteger(1));
+    return is_negative_ ? -value : value;
+}
+
+BigInteger::operator long double() const {
+    if (digits_.size() == 1 && digits_[0] == 0) {
+        return 0;
+    }
+    long double value = roundQuotient<long double>(*this, BigInteger(1));
+    return is_negative_ ? -value : value;
+}
+
+int BigInteger::bitLength(unsigned __int128 value) {
+    unsigned long long high = static_cast<unsigned long long>(value >> 64);
+    if (high != 0) {
+        return 128 - __builtin_clzll(high);
+    }
+    return (value == 0) ? 0 : 64 - __builtin_clzll(static_cast<unsigned long long>(value));
+}
+
+// Exact for binary limbs; for decimal limbs within one of floor(log2 |value|) + 1.
+long long BigInteger::bitLengthEstimate(const BigInteger& value) {
+    size_t n = value.digits_.size();
+    if (kBinaryLimbs_) {
+        return static_cast<long long>(64 * n) - __builtin_clzll(static_cast<unsigned long long>(value.digits_[n - 1]));
+    }
+    double bits = std::log2(static_cast<double>(value.digits_[n - 1])) +
+                  static_cast<double>(n - 1) * std::log2(static_cast<double>(kBase_));
+    return static_cast<long long>(bits) + 1;
+}
+
+BigInteger BigInteger::powerOfTwo(size_t exponent) {
+    BigInteger result;
+    if (kBinaryLimbs_) {
+        result.digits_.assign(exponent / 64 + 1, 0);
+        result.digits_.back() = static_cast<Limb>(1ull << (exponent % 64));
+        return result;
+    }
+    result = 1;
+    for (size_t bit = (exponent == 0) ? 0 : size_t(1) << (63 - __builtin_clzll(exponent)); bit != 0; bit >>= 1) {
+        result *= result;
+        if ((exponent & bit) != 0) {
+            result += result;
+        }
+    }
+    return result;
+}
+
+// Rounds (q + sticky part) / 2^shift, where q has at least digits + 2 bits and sticky tells
+// whether anything nonzero was cut below q.
+template <typename Float>
+Float BigInteger::roundScaled(unsigned __int128 q, long long shift, bool sticky) {
+    const long long min_exponent = std::numeric_limits<Float>::min_exponent;
+    int length = bitLength(q);
+    long long exponent = length - shift;
+    long long precision = std::numeric_limits<Float>::digits;
+    if (exponent < min_exponent) {
+        precision -= min_exponent - exponent;
+    }
+    if (precision < 0) {
+        return 0;
+    }
+    int drop = length - static_cast<int>(precision);
+    unsigned __int128 mantissa = q >> drop;
+    unsigned __int128 rest = q - (mantissa << drop);
+    unsigned __int128 half = static_cast<unsigned __int128>(1) << (drop - 1);
+    if (rest > half || (rest == half && (sticky || (mantissa & 1) != 0))) {
+        ++mantissa;
+    }
+    return std::ldexp(static_cast<Float>(mantissa), static_cast<int>(drop - shift));
+}
+
+// Scales a / b by 2^shift so that the quotient has digits + 2..digits + 7 bits and divides
+// once. The exponent estimate also settles overflow and underflow before any big arithmetic.
+template <typename Float>
+Float BigInteger::roundQuotientExact(const BigInteger& a, const BigInteger& b) {
+    const int digits = std::numeric_limits<Float>::digits;
+    long long estimate = bitLengthEstimate(a) - bitLengthEstimate(b);
+    if (estimate > std::numeric_limits<Float>::max_exponent + 2) {
+        return std::numeric_limits<Float>::infinity();
+    }
+    if (estimate < std::numeric_limits<Float>::min_exponent - digits - 3) {
+        return 0;
+    }
+    long long shift = digits + 4 - estimate;
+    BigInteger numer = a, denom = b;
+    if (shift >= 0) {
+        numer *= powerOfTwo(static_cast<size_t>(shift));
+    } else {
+        denom *= powerOfTwo(static_cast<size_t>(-shift));
+    }
+    BigInteger quotient, remainder;
+    divmod(numer, denom, quotient, remainder);
+    unsigned __int128 q = 0;
+    toSmall(quotient.digits_.data(), quotient.digits_.size(), q);
+    return roundScaled<Float>(q, shift, !(remainder == 0));
+}
+
+// Operands that are exact in Float divide in hardware, operands of up to 128 bits in
+// __int128 with one of them shifted. Long operands are first cut to
+// their top kQuotientLimbs_ limbs: a / b lies strictly between a' / (b' + 1) and
+// (a' + 1) / b', and when both bounds round alike so does the quotient.
+template <typename Float>
+Float BigInteger::roundQuotient(const BigInteger& a, const BigInteger& b) {
+    const int digits = std::numeric_limits<Float>::digits;
+    unsigned __int128 x, y;
+    if (toSmall(b.digits_.data(), b.digits_.size(), y) && (y >> digits) == 0 &&
+        toSmall(a.digits_.data(), a.digits_.size(), x) && (y == 1 || (x >> digits) == 0)) {
+        return (y == 1) ? static_cast<Float>(x) : static_cast<Float>(x) / static_cast<Float>(y);
+    }
+    if (toSmall(a.digits_.data(), a.digits_.size(), x) && toSmall(b.digits_.data(), b.digits_.size(), y)) {
+        int x_length = bitLength(x);
+        long long shift = digits + 2 - (x_length - bitLength(y));
+        if (shift < 0) {
+            y <<= -shift;
+            return roundScaled<Float>(x / y, shift, x % y != 0);
+        }
+        if (x_length + shift < 128) {
+            x <<= shift;
+            return roundScaled<Float>(x / y, shift, x % y != 0);
+        }
+    }
+    size_t n = a.digits_.size(), m = b.digits_.size();
+    if (std::min(n, m) > kQuotientLimbs_) {
+        size_t drop = std::min(n, m) - kQuotientLimbs_;
+        BigInteger a_top, b_top;
+        a_top.assignLimbs(a.digits_.data() + drop, n - drop, false);
+        b_top.assignLimbs(b.digits_.data() + drop, m - drop, false);
+        Float low = roundQuotientExact<Float>(a_top, b_top + 1);
+        Float high = roundQuotientExact<Float>(a_top + 1, b_top);
+        if (low == high) {
+            return low;
+        }
+    }
+    return roundQuotientExact<Float>(a, b);
+}
+
 BigInteger operator""_bi(unsigned long long value) {
     return BigInteger(value);
 }
 
-const std::vector<int>& BigInteger::data() const {
+BigInteger operator""_bi(const char* string, size_t length) {
+    BigInteger value;
+    value.fromChars(string, string + length);
+    return value;
+}
+
+const BigInteger::LimbVector& BigInteger::data() const {
     return digits_;
 }
 
@@ -116,6 +695,17 @@ bool BigInteger::is_negative() const {
     return is_negative_;
 }
 
+// Hashes the sign and the significant limbs, so equal values hash equally. Decimal and
+// binary builds have different limbs and therefore different hashes.
+size_t BigInteger::hash() const {
+    size_t n = trimLimbs(digits_.data(), digits_.size());
+    return ByteHash::hash(digits_.data(), n * sizeof(Limb), is_negative_ ? 1 : 0);
+}
+
+void BigInteger::reserve(size_t limbs) {
+    digits_.reserve(limbs);
+}
+
 void BigInteger::makeUnsigned() {
     is_negative_ = false;
 }
@@ -126,52 +716,204 @@ void BigInteger::popZeros() {
     }
 }
 
+void BigInteger::negate() {
+    if (digits_.size() > 1 || digits_[0] != 0) {
+        is_negative_ = !is_negative_;
+    }
+}
+
 void swap(BigInteger& first, BigInteger& second) {
-    BigInteger tmp = first;
-    first = second;
-    second = tmp;
+    first.digits_.swap(second.digits_);
+    std::swap(first.is_negative_, second.is_negative_);
 }
 
 std::string BigInteger::toString() const {
-    std::string str;
-    if (is_negative_) { str += "-"; }
-    str += std::to_string(digits_[digits_.size() - 1]);
-    for (int i = static_cast<int>(digits_.size()) - 2; i >= 0; --i) {
-        std::string support = std::to_string(digits_[i]);
-        std::reverse(support.begin(), support.end());
-        while (support.length() < kDigitLength_) {
-            support.push_back('0');
-        }
-        std::reverse(support.begin(), support.end());
-        str += support;
-    }
+    std::vector<Limb> storage;
+    const Limb* chunks;
+    size_t n = decimalChunks(storage, chunks);
+    std::string str(decimalLength(chunks, n, is_negative_), '0');
+    writeDecimal(chunks, n, is_negative_, str.data() + str.size());
     return str;
 }
 
-bool operator<(const BigInteger& a, const BigInteger& b) {
-    if (a.is_negative() + b.is_negative() == 1) {
-        return a.is_negative();
+size_t BigInteger::decimalLength() const {
+    std::vector<Limb> storage;
+    const Limb* chunks;
+    size_t n = decimalChunks(storage, chunks);
+    return decimalLength(chunks, n, is_negative_);
+}
+
+size_t BigInteger::decimalLength(const Limb* chunks, size_t n, bool negative) {
+    size_t length = negative ? 1 : 0;
+    for (Limb top = chunks[n - 1]; top >= 10; top /= 10) {
+        ++length;
     }
-    if (a.is_negative()) {
-        if (a.data().size() != b.data().size()) {
-            return (b.data().size() < a.data().size());
+    return length + 1 + (n - 1) * kDigitLength_;
+}
+
+// Writes the digits backwards so that the last one lands just before end.
+void BigInteger::writeDecimal(const Limb* chunks, size_t n, bool negative, char* end) {
+    char* pos = end;
+    for (size_t i = 0; i + 1 < n; ++i) {
+        Limb chunk = chunks[i];
+        for (int j = 0; j < kDigitLength_; ++j) {
+            *--pos = static_cast<char>('0' + chunk % 10);
+            chunk /= 10;
         }
-        for (int i = static_cast<int>(a.data().size()) - 1; i >= 0; --i) {
-            if (a.data()[i] != b.data()[i]) {
-                return (b.data()[i] < a.data()[i]);
-            }
+    }
+    Limb top = chunks[n - 1];
+    do {
+        *--pos = static_cast<char>('0' + top % 10);
+        top /= 10;
+    } while (top > 0);
+    if (negative) {
+        *--pos = '-';
+    }
+}
+
+std::to_chars_result BigInteger::toChars(char* first, char* last) const {
+    std::vector<Limb> storage;
+    const Limb* chunks;
+    size_t n = decimalChunks(storage, chunks);
+    size_t length = decimalLength(chunks, n, is_negative_);
+    if (static_cast<size_t>(last - first) < length) {
+        return {last, std::errc::value_too_large};
+    }
+    writeDecimal(chunks, n, is_negative_, first + length);
+    return {first + length, std::errc()};
+}
+
+std::from_chars_result BigInteger::fromChars(const char* first, const char* last) {
+    const char* begin = first;
+    bool negative = (begin != last && *begin == '-');
+    if (negative) {
+        ++begin;
+    }
+    const char* end = begin;
+    while (end != last && *end >= '0' && *end <= '9') {
+        ++end;
+    }
+    if (end == begin) {
+        return {first, std::errc::invalid_argument};
+    }
+    std::vector<Limb> chunks((end - begin + kDigitLength_ - 1) / kDigitLength_);
+    const char* pos = end;
+    for (Limb& chunk : chunks) {
+        const char* from = (pos - begin > kDigitLength_) ? pos - kDigitLength_ : begin;
+        chunk = 0;
+        for (const char* c = from; c != pos; ++c) {
+            chunk = chunk * 10 + (*c - '0');
         }
-    } else {
-        if (a.data().size() != b.data().size()) {
-            return (a.data().size() < b.data().size());
+        pos = from;
+    }
+    if (kBinaryLimbs_) {
+        std::vector<std::vector<Limb>> powers;
+        decimalPowers(chunks.size(), powers);
+        std::vector<Limb> limbs;
+        decimalToLimbs(chunks.data(), chunks.size(), powers, limbs);
+        chunks.swap(limbs);
+    }
+    assignLimbs(chunks.data(), chunks.size(), negative);
+    return {end, std::errc()};
+}
+
+// powers[k] = kDecimalChunk_^(2^k), for every 2^k below the given number of chunks.
+void BigInteger::decimalPowers(size_t chunks, std::vector<std::vector<Limb>>& powers) {
+    powers.assign(1, std::vector<Limb>(1, kDecimalChunk_));
+    while ((size_t(2) << (powers.size() - 1)) < chunks) {
+        const std::vector<Limb>& last = powers.back();
+        std::vector<Limb> square(2 * last.size());
+        mulLimbs(last.data(), last.size(), last.data(), last.size(), square.data());
+        square.resize(trimLimbs(square.data(), square.size()));
+        powers.push_back(square);
+    }
+}
+
+// Appends the base-kDecimalChunk_ digits of a[0..n) to chunks (least significant first),
+// zero-padded to width chunks when width != 0. The value is split by the largest cached
+// power that is at most half its size, so the cost is dominated by a few big divisions.
+void BigInteger::limbsToDecimal(const Limb* a, size_t n, const std::vector<std::vector<Limb>>& powers,
+                                size_t width, std::vector<Limb>& chunks) {
+    n = trimLimbs(a, n);
+    size_t start = chunks.size();
+    size_t level = powers.size();
+    while (level > 0 && powers[level - 1].size() * 2 > n + 1) {
+        --level;
+    }
+    if (n <= kRadixThreshold_ || level == 0) {
+        std::vector<Limb> value(a, a + n);
+        while (n > 0) {
+            chunks.push_back(divSmallLimbs(value.data(), n, kDecimalChunk_));
+            n = trimLimbs(value.data(), n);
         }
-        for (int i = static_cast<int>(a.data().size()) - 1; i >= 0; --i) {
-            if (a.data()[i] != b.data()[i]) {
-                return (a.data()[i] < b.data()[i]);
+    } else {
+        const std::vector<Limb>& power = powers[level - 1];
+        std::vector<Limb> quotient, remainder;
+        divmodLimbs(a, n, power.data(), power.size(), quotient, remainder);
+        limbsToDecimal(remainder.data(), remainder.size(), powers, size_t(1) << (level - 1), chunks);
+        limbsToDecimal(quotient.data(), quotient.size(), powers, 0, chunks);
+    }
+    if (width != 0) {
+        chunks.resize(start + width, 0);
+    }
+}
+
+void BigInteger::decimalToLimbs(const Limb* chunks, size_t n, const std::vector<std::vector<Limb>>& powers,
+                                std::vector<Limb>& limbs) {
+    if (n <= kRadixThreshold_) {
+        limbs.assign(n + 1, 0);
+        size_t size = 0;
+        for (size_t i = n; i > 0; --i) {
+            Limb carry = mulSmallLimbs(limbs.data(), size, kDecimalChunk_);
+            if (carry != 0) {
+                limbs[size++] = carry;
+            }
+            if (addLimbs(limbs.data(), size + 1, chunks + i - 1, 1) != 0 || limbs[size] != 0) {
+                ++size;
             }
         }
+        limbs.resize(size);
+        return;
     }
-    return false;
+    size_t level = 0;
+    while ((size_t(2) << level) < n) {
+        ++level;
+    }
+    size_t low_size = size_t(1) << level;
+    std::vector<Limb> low, high;
+    decimalToLimbs(chunks, low_size, powers, low);
+    decimalToLimbs(chunks + low_size, n - low_size, powers, high);
+    const std::vector<Limb>& power = powers[level];
+    limbs.assign(high.size() + power.size() + 1, 0);
+    mulLimbs(high.data(), high.size(), power.data(), power.size(), limbs.data());
+    addLimbs(limbs.data(), limbs.size(), low.data(), low.size());
+    limbs.resize(trimLimbs(limbs.data(), limbs.size()));
+}
+
+// The limbs themselves in base 10^9; a converted copy in storage for binary limbs.
+size_t BigInteger::decimalChunks(std::vector<Limb>& storage, const Limb*& chunks) const {
+    if (!kBinaryLimbs_) {
+        chunks = digits_.data();
+        return digits_.size();
+    }
+    size_t n = trimLimbs(digits_.data(), digits_.size());
+    std::vector<std::vector<Limb>> powers;
+    decimalPowers(n * 2, powers);
+    limbsToDecimal(digits_.data(), n, powers, 0, storage);
+    if (storage.empty()) {
+        storage.push_back(0);
+    }
+    chunks = storage.data();
+    return storage.size();
+}
+
+bool operator<(const BigInteger& a, const BigInteger& b) {
+    if (a.is_negative() != b.is_negative()) {
+        return a.is_negative();
+    }
+    int cmp = BigInteger::compareLimbs(a.digits_.data(), a.digits_.size(),
+                                       b.digits_.data(), b.digits_.size());
+    return a.is_negative() ? (cmp > 0) : (cmp < 0);
 }
 
 bool operator<=(const BigInteger& a, const BigInteger& b) {
@@ -187,15 +929,9 @@ bool operator>=(const BigInteger& a, const BigInteger& b) {
 }
 
 bool operator==(const BigInteger& a, const BigInteger& b) {
-    if (a.data().size() == b.data().size()) {
-        for (int i = 0, j = 0; i < static_cast<int>(a.data().size()); i++, j++) {
-            if (a.data()[i] != b.data()[i]) {
-                return false;
-            }
-        }
-        return true;
-    }
-    return false;
+    return a.is_negative() == b.is_negative() &&
+           BigInteger::compareLimbs(a.digits_.data(), a.digits_.size(),
+                                    b.digits_.data(), b.digits_.size()) == 0;
 }
 
 bool operator!=(const BigInteger& a, const BigInteger& b) {
@@ -203,35 +939,149 @@ bool operator!=(const BigInteger& a, const BigInteger& b) {
 }
 
 BigInteger operator+(const BigInteger& left, const BigInteger& other) {
-    BigInteger value = left;
+    BigInteger value;
+    value.reserve(std::max(left.data().size(), other.data().size()) + 1);
+    value = left;
     value += other;
     return value;
 }
 
+BigInteger operator+(BigInteger&& left, const BigInteger& other) {
+    left += other;
+    return std::move(left);
+}
+
+BigInteger operator+(const BigInteger& left, BigInteger&& other) {
+    other += left;
+    return std::move(other);
+}
+
+BigInteger operator+(BigInteger&& left, BigInteger&& other) {
+    left += other;
+    return std::move(left);
+}
+
 BigInteger operator-(const BigInteger& left, const BigInteger& other) {
-    BigInteger value = left;
+    BigInteger value;
+    value.reserve(std::max(left.data().size(), other.data().size()) + 1);
+    value = left;
     value -= other;
     return value;
 }
 
+BigInteger operator-(BigInteger&& left, const BigInteger& other) {
+    left -= other;
+    return std::move(left);
+}
+
+BigInteger operator-(const BigInteger& left, BigInteger&& other) {
+    other -= left;
+    return -std::move(other);
+}
+
+BigInteger operator-(BigInteger&& left, BigInteger&& other) {
+    left -= other;
+    return std::move(left);
+}
+
 BigInteger operator*(const BigInteger& left, const BigInteger& other) {
-    BigInteger value = left;
-    value *= other;
+    BigInteger value;
+    value.assignProduct(left, other);
     return value;
 }
 
+BigInteger operator*(BigInteger&& left, const BigInteger& other) {
+    left *= other;
+    return std::move(left);
+}
+
+BigInteger operator*(const BigInteger& left, BigInteger&& other) {
+    other *= left;
+    return std::move(other);
+}
+
+BigInteger operator*(BigInteger&& left, BigInteger&& other) {
+    left *= other;
+    return std::move(left);
+}
+
 BigInteger operator/(const BigInteger& left, const BigInteger& other) {
-    BigInteger value = left;
-    value /= other;
+    BigInteger value, remainder;
+    divmod(left, other, value, remainder);
     return value;
 }
 
+BigInteger operator/(BigInteger&& left, const BigInteger& other) {
+    left /= other;
+    return std::move(left);
+}
+
 BigInteger operator%(const BigInteger& left, const BigInteger& other) {
+    BigInteger quotient, value;
+    divmod(left, other, quotient, value);
+    return value;
+}
+
+BigInteger operator%(BigInteger&& left, const BigInteger& other) {
+    left %= other;
+    return std::move(left);
+}
+
+BigInteger operator<<(const BigInteger& left, size_t shift) {
+    BigInteger value = left;
+    value <<= shift;
+    return value;
+}
+
+BigInteger operator<<(BigInteger&& left, size_t shift) {
+    left <<= shift;
+    return std::move(left);
+}
+
+BigInteger operator>>(const BigInteger& left, size_t shift) {
+    BigInteger value = left;
+    value >>= shift;
+    return value;
+}
+
+BigInteger operator>>(BigInteger&& left, size_t shift) {
+    left >>= shift;
+    return std::move(left);
+}
+
+BigInteger operator&(const BigInteger& left, const BigInteger& other) {
+    BigInteger value = left;
+    value &= other;
+    return value;
+}
+
+BigInteger operator&(BigInteger&& left, const BigInteger& other) {
+    left &= other;
+    return std::move(left);
+}
+
+BigInteger operator|(const BigInteger& left, const BigInteger& other) {
+    BigInteger value = left;
+    value |= other;
+    return value;
+}
+
+BigInteger operator|(BigInteger&& left, const BigInteger& other) {
+    left |= other;
+    return std::move(left);
+}
+
+BigInteger operator^(const BigInteger& left, const BigInteger& other) {
     BigInteger value = left;
-    value %= other;
+    value ^= other;
     return value;
 }
 
+BigInteger operator^(BigInteger&& left, const BigInteger& other) {
+    left ^= other;
+    return std::move(left);
+}
+
 BigInteger& BigInteger::operator++() {
     *this += 1;
     return *this;
@@ -254,168 +1104,2279 @@ BigInteger BigInteger::operator--(int) {
     return copy;
 }
 
-BigInteger BigInteger::operator-() const {
+BigInteger BigInteger::operator-() const& {
     BigInteger copy = *this;
-    if (copy != 0_bi) {
-        copy.is_negative_ = !copy.is_negative();
+    return -std::move(copy);
+}
+
+BigInteger BigInteger::operator-() && {
+    if (digits_.size() > 1 || digits_[0] != 0) {
+        is_negative_ = !is_negative_;
     }
-    return copy;
+    return std::move(*this);
 }
 
 void BigInteger::addPositive(const BigInteger& other) {
-    while (digits_.size() <= other.data().size()) {
-        digits_.push_back(0);
+    if (digits_.size() < other.data().size()) {
+        digits_.resize(other.data().size(), 0);
     }
-    for (int i = 0; i < static_cast<int>(other.data().size()); ++i) {
-        if (digits_[i] + other.data()[i] < kBase_) {
-            digits_[i] += other.data()[i];
-        } else {
-            digits_[i] = (digits_[i] + other.data()[i]) % kBase_;
-            digits_[i + 1] += 1;
-        }
+    Limb carry = addLimbs(digits_.data(), digits_.size(), other.data().data(), other.data().size());
+    if (carry != 0) {
+        digits_.push_back(carry);
     }
-    popZeros();
 }
 
-void BigInteger::subtractPositive(BigInteger other) {
-    makeUnsigned();
-    other.makeUnsigned();
-    if (*this < other) {
-        swap(*this, other);
+// |*this| - |other| in place; the sign of the result is negative iff |*this| < |other|.
+void BigInteger::subtractPositive(const BigInteger& other) {
+    size_t m = trimLimbs(other.data().data(), other.data().size());
+    if (compareLimbs(digits_.data(), digits_.size(), other.data().data(), m) >= 0) {
+        subLimbs(digits_.data(), digits_.size(), other.data().data(), m);
+        is_negative_ = false;
+    } else {
+        digits_.resize(m, 0);
+        reverseSubLimbs(digits_.data(), other.data().data(), m);
         is_negative_ = true;
     }
-    while (other.data().size() < digits_.size()) {
-        other.digits_.push_back(0);
-    }
-    for (int i = 0; i < static_cast<int>(digits_.size()); ++i) {
-        if (digits_[i] - other.data()[i] >= 0) {
-            digits_[i] -= other.data()[i];
-        } else {
-            digits_[i] = kBase_ + (digits_[i] - other.data()[i]);
-            digits_[i + 1] -= 1;
-        }
-    }
     popZeros();
 }
 
 BigInteger& BigInteger::operator+=(const BigInteger& other) {
-    if (this == &other) {
-        BigInteger copy = *this;
-        *this += copy;
-        return *this;
-    }
     if (is_negative_ == other.is_negative()) {
         addPositive(other);
         return *this;
     }
-    if (is_negative_) {
-        subtractPositive(other);
-        if (*this != 0) {
-            is_negative_ = !(is_negative_);
-        }
-    } else {
-        subtractPositive(other);
+    bool negative = is_negative_;
+    subtractPositive(other);
+    if (negative && (digits_.size() > 1 || digits_[0] != 0)) {
+        is_negative_ = !is_negative_;
     }
     return *this;
 }
 
 BigInteger& BigInteger::operator-=(const BigInteger& other) {
-    if (this == &other) {
-        *this = 0_bi;
-        return *this;
-    }
     if (is_negative_ != other.is_negative()) {
         addPositive(other);
         return *this;
     }
-    if (is_negative_) {
-        subtractPositive(other);
-        if (*this != 0) {
-            is_negative_ = !(is_negative_);
-        }
-    } else {
-        subtractPositive(other);
+    bool negative = is_negative_;
+    subtractPositive(other);
+    if (negative && (digits_.size() > 1 || digits_[0] != 0)) {
+        is_negative_ = !is_negative_;
     }
     return *this;
 }
 
-BigInteger& BigInteger::operator*=(const BigInteger& other) {
-    BigInteger result = 0;
-    BigInteger other_copy = other;
-    bool res_is_negative = (is_negative_ != other_copy.is_negative());
-    other_copy.makeUnsigned();
-    makeUnsigned();
-    if (*this < other_copy) {
-        swap(*this, other_copy);
-    }
-    BigInteger support;
-    int tmp = 0;
-    for (int i = 0; i < static_cast<int>(other_copy.data().size()); ++i) {
-        support.digits_.resize(digits_.size() + 1 + i, 0);
-        for (int k = 0; k < static_cast<int>(digits_.size()); k++) {
-            support.digits_[k + i] = static_cast<int>((((static_cast<long long>(digits_[k]) * static_cast<long long>(other_copy.data()[i])) + static_cast<long long>(tmp)) % static_cast<long long>(kBase_)));
-            tmp = static_cast<int>((((static_cast<long long>(digits_[k]) * static_cast<long long>(other_copy.data()[i])) + static_cast<long long>(tmp)) / static_cast<long long>(kBase_)));
-        }
-        support.digits_[digits_.size() + i] = tmp;
-        support.popZeros();
-        result += support;
-        support = 0;
-        tmp = 0;
-    }
-    *this = result;
-    popZeros();
-    is_negative_ = res_is_negative;
-    return *this;
+size_t BigInteger::trimLimbs(const Limb* a, size_t n) {
+    while (n > 0 && a[n - 1] == 0) {
+        --n;
+    }
+    return n;
+}
+
+inline int BigInteger::compareLimbs(const Limb* a, size_t n, const Limb* b, size_t m) {
+    n = trimLimbs(a, n);
+    m = trimLimbs(b, m);
+    if (n != m) {
+        return (n < m) ? -1 : 1;
+    }
+    size_t i = n;
+#ifdef BIGINTEGER_AVX2_KERNELS
+    if (n >= kSimdThreshold_ && hasAvx2()) {
+        i = mismatchLimbsAvx2(a, b, n);
+    }
+#endif
+    for (; i > 0; --i) {
+        if (a[i - 1] != b[i - 1]) {
+            return (a[i - 1] < b[i - 1]) ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// a[0..n) += b[0..m), n >= m; returns the carry out of a[n - 1].
+BigInteger::Limb BigInteger::addLimbs(Limb* a, size_t n, const Limb* b, size_t m) {
+    Limb carry = 0;
+    size_t i = 0;
+#ifdef BIGINTEGER_AVX2_KERNELS
+    if (m >= kSimdThreshold_ && hasAvx2()) {
+        i = addLimbsAvx2(a, b, m, carry);
+    }
+#endif
+    if (kBinaryLimbs_) {
+        for (; i < m; ++i) {
+            Limb sum;
+            bool overflow = __builtin_add_overflow(a[i], b[i], &sum);
+            overflow |= __builtin_add_overflow(sum, carry, &a[i]);
+            carry = overflow;
+        }
+    }
+    for (; i < m; ++i) {
+        DoubleLimb sum = static_cast<DoubleLimb>(a[i]) + b[i] + carry;
+        carry = (sum >= kBase_) ? 1 : 0;
+        a[i] = static_cast<Limb>(sum - carry * kBase_);
+    }
+    for (; carry != 0 && i < n; ++i) {
+        if (static_cast<DoubleLimb>(a[i]) + 1 == kBase_) {
+            a[i] = 0;
+        } else {
+            ++a[i];
+            carry = 0;
+        }
+    }
+    return carry;
+}
+
+// a[0..n) -= b[0..m), n >= m; returns the borrow out of a[n - 1].
+BigInteger::Limb BigInteger::subLimbs(Limb* a, size_t n, const Limb* b, size_t m) {
+    Limb borrow = 0;
+    size_t i = 0;
+#ifdef BIGINTEGER_AVX2_KERNELS
+    if (m >= kSimdThreshold_ && hasAvx2()) {
+        i = subLimbsAvx2(a, a, b, m, borrow);
+    }
+#endif
+    if (kBinaryLimbs_) {
+        for (; i < m; ++i) {
+            Limb diff;
+            bool overflow = __builtin_sub_overflow(a[i], b[i], &diff);
+            overflow |= __builtin_sub_overflow(diff, borrow, &a[i]);
+            borrow = overflow;
+        }
+    }
+    for (; i < m; ++i) {
+        DoubleLimb deduction = static_cast<DoubleLimb>(b[i]) + borrow;
+        borrow = (a[i] < deduction) ? 1 : 0;
+        a[i] = static_cast<Limb>(a[i] + borrow * kBase_ - deduction);
+    }
+    for (; borrow != 0 && i < n; ++i) {
+        if (a[i] == 0) {
+            a[i] = static_cast<Limb>(kBase_ - 1);
+        } else {
+            --a[i];
+            borrow = 0;
+        }
+    }
+    return borrow;
+}
+
+// a[0..n) = b[0..n) - a[0..n); returns the borrow.
+BigInteger::Limb BigInteger::reverseSubLimbs(Limb* a, const Limb* b, size_t n) {
+    Limb borrow = 0;
+    size_t i = 0;
+#ifdef BIGINTEGER_AVX2_KERNELS
+    if (n >= kSimdThreshold_ && hasAvx2()) {
+        i = subLimbsAvx2(a, b, a, n, borrow);
+    }
+#endif
+    if (kBinaryLimbs_) {
+        for (; i < n; ++i) {
+            Limb diff;
+            bool overflow = __builtin_sub_overflow(b[i], a[i], &diff);
+            overflow |= __builtin_sub_overflow(diff, borrow, &a[i]);
+            borrow = overflow;
+        }
+    }
+    for (; i < n; ++i) {
+        DoubleLimb deduction = static_cast<DoubleLimb>(a[i]) + borrow;
+        borrow = (b[i] < deduction) ? 1 : 0;
+        a[i] = static_cast<Limb>(b[i] + borrow * kBase_ - deduction);
+    }
+    return borrow;
+}
+
+#ifdef BIGINTEGER_AVX2_KERNELS
+bool BigInteger::hasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+// The vector kernels add or subtract whole registers of limbs lane-wise and then settle the
+// carries of a register at once: with g the lanes that overflowed and p the lanes that pass an
+// incoming carry on (sum at its maximum, difference zero), x = (g << 1 | carry) + p is the
+// carry chain, x ^ p the lanes that receive a carry and the bit above the lanes the carry out.
+// Each returns the number of limbs it handled; the scalar loop finishes the tail.
+#ifdef BIGINTEGER_BINARY_LIMBS
+__attribute__((target("avx2"), noinline))
+size_t BigInteger::addLimbsAvx2(Limb* a, const Limb* b, size_t m, Limb& carry) {
+    const __m256i sign = _mm256_set1_epi64x(static_cast<long long>(1ull << 63));
+    const __m256i ones = _mm256_set1_epi64x(-1);
+    const __m256i lanes = _mm256_setr_epi64x(1, 2, 4, 8);
+    unsigned chain = static_cast<unsigned>(carry);
+    size_t i = 0;
+    for (; i + 4 <= m; i += 4) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        __m256i sum = _mm256_add_epi64(va, vb);
+        __m256i g = _mm256_cmpgt_epi64(_mm256_xor_si256(va, sign), _mm256_xor_si256(sum, sign));
+        __m256i p = _mm256_cmpeq_epi64(sum, ones);
+        unsigned gm = _mm256_movemask_pd(_mm256_castsi256_pd(g));
+        unsigned pm = _mm256_movemask_pd(_mm256_castsi256_pd(p));
+        unsigned x = ((gm << 1) | chain) + pm;
+        __m256i in = _mm256_set1_epi64x((x ^ pm) & 15);
+        sum = _mm256_sub_epi64(sum, _mm256_cmpeq_epi64(_mm256_and_si256(in, lanes), lanes));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(a + i), sum);
+        chain = x >> 4;
+    }
+    carry = chain;
+    return i;
+}
+
+__attribute__((target("avx2"), noinline))
+size_t BigInteger::subLimbsAvx2(Limb* out, const Limb* a, const Limb* b, size_t m, Limb& borrow) {
+    const __m256i sign = _mm256_set1_epi64x(static_cast<long long>(1ull << 63));
+    const __m256i lanes = _mm256_setr_epi64x(1, 2, 4, 8);
+    unsigned chain = static_cast<unsigned>(borrow);
+    size_t i = 0;
+    for (; i + 4 <= m; i += 4) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        __m256i diff = _mm256_sub_epi64(va, vb);
+        __m256i g = _mm256_cmpgt_epi64(_mm256_xor_si256(vb, sign), _mm256_xor_si256(va, sign));
+        __m256i p = _mm256_cmpeq_epi64(diff, _mm256_setzero_si256());
+        unsigned gm = _mm256_movemask_pd(_mm256_castsi256_pd(g));
+        unsigned pm = _mm256_movemask_pd(_mm256_castsi256_pd(p));
+        unsigned x = ((gm << 1) | chain) + pm;
+        __m256i in = _mm256_set1_epi64x((x ^ pm) & 15);
+        diff = _mm256_add_epi64(diff, _mm256_cmpeq_epi64(_mm256_and_si256(in, lanes), lanes));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), diff);
+        chain = x >> 4;
+    }
+    borrow = chain;
+    return i;
+}
+
+// Returns k with a[k..n) == b[k..n), stopping at the highest register that differs.
+__attribute__((target("avx2"), noinline))
+size_t BigInteger::mismatchLimbsAvx2(const Limb* a, const Limb* b, size_t n) {
+    size_t i = n;
+    for (; i >= 4; i -= 4) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i - 4));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i - 4));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi64(va, vb)) != -1) {
+            break;
+        }
+    }
+    return i;
+}
+#else
+__attribute__((target("avx2"), noinline))
+size_t BigInteger::addLimbsAvx2(Limb* a, const Limb* b, size_t m, Limb& carry) {
+    const __m256i top = _mm256_set1_epi32(static_cast<int>(kBase_ - 1));
+    const __m256i base = _mm256_set1_epi32(static_cast<int>(kBase_));
+    const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    unsigned chain = static_cast<unsigned>(carry);
+    size_t i = 0;
+    for (; i + 8 <= m; i += 8) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        __m256i sum = _mm256_add_epi32(va, vb);
+        __m256i g = _mm256_cmpgt_epi32(sum, top);
+        __m256i p = _mm256_cmpeq_epi32(sum, top);
+        unsigned gm = _mm256_movemask_ps(_mm256_castsi256_ps(g));
+        unsigned pm = _mm256_movemask_ps(_mm256_castsi256_ps(p));
+        unsigned x = ((gm << 1) | chain) + pm;
+        __m256i in = _mm256_set1_epi32(static_cast<int>((x ^ pm) & 255));
+        sum = _mm256_sub_epi32(sum, _mm256_cmpeq_epi32(_mm256_and_si256(in, lanes), lanes));
+        sum = _mm256_sub_epi32(sum, _mm256_and_si256(_mm256_cmpgt_epi32(sum, top), base));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(a + i), sum);
+        chain = x >> 8;
+    }
+    carry = static_cast<Limb>(chain);
+    return i;
+}
+
+__attribute__((target("avx2"), noinline))
+size_t BigInteger::subLimbsAvx2(Limb* out, const Limb* a, const Limb* b, size_t m, Limb& borrow) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i base = _mm256_set1_epi32(static_cast<int>(kBase_));
+    const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    unsigned chain = static_cast<unsigned>(borrow);
+    size_t i = 0;
+    for (; i + 8 <= m; i += 8) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        __m256i diff = _mm256_sub_epi32(va, vb);
+        __m256i g = _mm256_cmpgt_epi32(zero, diff);
+        __m256i p = _mm256_cmpeq_epi32(diff, zero);
+        unsigned gm = _mm256_movemask_ps(_mm256_castsi256_ps(g));
+        unsigned pm = _mm256_movemask_ps(_mm256_castsi256_ps(p));
+        unsigned x = ((gm << 1) | chain) + pm;
+        __m256i in = _mm256_set1_epi32(static_cast<int>((x ^ pm) & 255));
+        diff = _mm256_add_epi32(diff, _mm256_cmpeq_epi32(_mm256_and_si256(in, lanes), lanes));
+        diff = _mm256_add_epi32(diff, _mm256_and_si256(_mm256_cmpgt_epi32(zero, diff), base));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), diff);
+        chain = x >> 8;
+    }
+    borrow = static_cast<Limb>(chain);
+    return i;
+}
+
+// Returns k with a[k..n) == b[k..n), stopping at the highest register that differs.
+__attribute__((target("avx2"), noinline))
+size_t BigInteger::mismatchLimbsAvx2(const Limb* a, const Limb* b, size_t n) {
+    size_t i = n;
+    for (; i >= 8; i -= 8) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i - 8));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i - 8));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(va, vb)) != -1) {
+            break;
+        }
+    }
+    return i;
+}
+#endif
+#endif
+
+BigInteger::Limb BigInteger::mulSmallLimbs(Limb* a, size_t n, Limb factor) {
+    DoubleLimb carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        DoubleLimb cur = static_cast<DoubleLimb>(a[i]) * factor + carry;
+        a[i] = static_cast<Limb>(cur % kBase_);
+        carry = cur / kBase_;
+    }
+    return static_cast<Limb>(carry);
+}
+
+BigInteger::Limb BigInteger::divSmallLimbs(Limb* a, size_t n, Limb divisor) {
+    DoubleLimb rem = 0;
+    for (size_t i = n; i > 0; --i) {
+        DoubleLimb cur = rem * kBase_ + a[i - 1];
+        a[i - 1] = static_cast<Limb>(cur / divisor);
+        rem = cur % divisor;
+    }
+    return static_cast<Limb>(rem);
+}
+
+void BigInteger::mulSchoolbook(const Limb* a, size_t n, const Limb* b, size_t m, Limb* out) {
+    std::fill(out, out + n + m, 0);
+    for (size_t i = 0; i < m; ++i) {
+        if (b[i] == 0) {
+            continue;
+        }
+        DoubleLimb factor = b[i];
+        DoubleLimb carry = 0;
+        for (size_t j = 0; j < n; ++j) {
+            DoubleLimb cur = out[i + j] + factor * a[j] + carry;
+            out[i + j] = static_cast<Limb>(cur % kBase_);
+            carry = cur / kBase_;
+        }
+        out[i + n] = static_cast<Limb>(carry);
+    }
+}
+
+// n >= 2m - 1: cut a into m-limb blocks so every sub-product is balanced.
+void BigInteger::mulUnbalanced(const Limb* a, size_t n, const Limb* b, size_t m, Limb* out) {
+    std::fill(out, out + n + m, 0);
+    std::vector<Limb> block(2 * m);
+    for (size_t i = 0; i < n; i += m) {
+        size_t len = std::min(m, n - i);
+        mulLimbs(a + i, len, b, m, block.data());
+        addLimbs(out + i, n + m - i, block.data(), trimLimbs(block.data(), len + m));
+    }
+}
+
+// (a1 x + a0)(b1 x + b0) = a1 b1 x^2 + ((a0 + a1)(b0 + b1) - a0 b0 - a1 b1) x + a0 b0, x = kBase_^k.
+void BigInteger::mulKaratsuba(const Limb* a, size_t n, const Limb* b, size_t m, Limb* out) {
+    size_t k = (n + 1) / 2;
+    std::fill(out, out + n + m, 0);
+    std::vector<Limb> sum_a(a, a + k), sum_b(b, b + k);
+    sum_a.push_back(0);
+    sum_b.push_back(0);
+    addLimbs(sum_a.data(), k + 1, a + k, n - k);
+    addLimbs(sum_b.data(), k + 1, b + k, m - k);
+    std::vector<Limb> middle(2 * k + 2);
+    forkJoin(m >= kParallelLimbs_,
+             [&] { mulLimbs(sum_a.data(), k + 1, sum_b.data(), k + 1, middle.data()); },
+             [&] { mulLimbs(a, k, b, k, out); },
+             [&] { mulLimbs(a + k, n - k, b + k, m - k, out + 2 * k); });
+    subLimbs(middle.data(), middle.size(), out, 2 * k);
+    subLimbs(middle.data(), middle.size(), out + 2 * k, n + m - 2 * k);
+    addLimbs(out + k, n + m - k, middle.data(), trimLimbs(middle.data(), middle.size()));
+}
+
+// Evaluates at 0, 1, -1, 2 and infinity; the interpolation order keeps every
+// intermediate non-negative, so only the value at -1 needs a sign.
+void BigInteger::mulToom3(const Limb* a, size_t n, const Limb* b, size_t m, Limb* out) {
+    size_t k = (n + 2) / 3;
+    size_t a_len[3] = {k, k, n - 2 * k};
+    size_t b_len[3] = {std::min(k, m), (m > k) ? std::min(k, m - k) : 0, (m > 2 * k) ? m - 2 * k : 0};
+    const Limb* a_part[3] = {a, a + k, a + 2 * k};
+    const Limb* b_part[3] = {b, b + std::min(k, m), b + std::min(2 * k, m)};
+
+    auto evaluate = [k](const Limb* const* part, const size_t* len, std::vector<Limb>& at_one,
+                        std::vector<Limb>& at_minus_one, std::vector<Limb>& at_two) {
+        std::vector<Limb> even(part[0], part[0] + len[0]);
+        even.resize(k + 1, 0);
+        addLimbs(even.data(), k + 1, part[2], len[2]);
+        at_one = even;
+        addLimbs(at_one.data(), k + 1, part[1], len[1]);
+
+        std::vector<Limb> odd(part[1], part[1] + len[1]);
+        odd.resize(k + 1, 0);
+        bool negative = compareLimbs(even.data(), k + 1, odd.data(), k + 1) < 0;
+        at_minus_one = negative ? odd : even;
+        subLimbs(at_minus_one.data(), k + 1, (negative ? even : odd).data(), k + 1);
+
+        at_two.assign(part[2], part[2] + len[2]);
+        at_two.resize(k + 1, 0);
+        mulSmallLimbs(at_two.data(), k + 1, 2);
+        addLimbs(at_two.data(), k + 1, part[1], len[1]);
+        mulSmallLimbs(at_two.data(), k + 1, 2);
+        addLimbs(at_two.data(), k + 1, part[0], len[0]);
+        return negative;
+    };
+
+    std::vector<Limb> a_one, a_minus_one, a_two, b_one, b_minus_one, b_two;
+    bool minus_one_negative = evaluate(a_part, a_len, a_one, a_minus_one, a_two) !=
+                              evaluate(b_part, b_len, b_one, b_minus_one, b_two);
+
+    size_t width = 2 * k + 3;
+    std::vector<Limb> r_one(width), r_minus_one(width), r_two(width);
+    std::fill(out, out + n + m, 0);
+    forkJoin(m >= kParallelLimbs_,
+             [&] { mulLimbs(a_one.data(), k + 1, b_one.data(), k + 1, r_one.data()); },
+             [&] { mulLimbs(a_minus_one.data(), k + 1, b_minus_one.data(), k + 1, r_minus_one.data()); },
+             [&] { mulLimbs(a_two.data(), k + 1, b_two.data(), k + 1, r_two.data()); },
+             [&] { mulLimbs(a_part[0], a_len[0], b_part[0], b_len[0], out); },
+             [&] {
+                 if (b_len[2] > 0) {
+                     mulLimbs(a_part[2], a_len[2], b_part[2], b_len[2], out + 4 * k);
+                 }
+             });
+    const Limb* c0 = out;
+    size_t c0_len = trimLimbs(out, 2 * k);
+    const Limb* c4 = out;
+    size_t c4_len = 0;
+    if (b_len[2] > 0) {
+        c4 = out + 4 * k;
+        c4_len = trimLimbs(c4, n + m - 4 * k);
+    }
+
+    // even = c0 + c2 + c4, odd = c1 + c3
+    std::vector<Limb> even = r_one, odd = r_one;
+    if (minus_one_negative) {
+        subLimbs(even.data(), width, r_minus_one.data(), width);
+        addLimbs(odd.data(), width, r_minus_one.data(), width);
+    } else {
+        addLimbs(even.data(), width, r_minus_one.data(), width);
+        subLimbs(odd.data(), width, r_minus_one.data(), width);
+    }
+    divSmallLimbs(even.data(), width, 2);
+    divSmallLimbs(odd.data(), width, 2);
+
+    std::vector<Limb>& c2 = even;
+    subLimbs(c2.data(), width, c0, c0_len);
+    subLimbs(c2.data(), width, c4, c4_len);
+
+    // r_two = c0 + 2 c1 + 4 c2 + 8 c3 + 16 c4  ->  c1 + 4 c3
+    std::vector<Limb> scaled(c2);
+    mulSmallLimbs(scaled.data(), width, 4);
+    std::vector<Limb>& c1_4c3 = r_two;
+    subLimbs(c1_4c3.data(), width, c0, c0_len);
+    subLimbs(c1_4c3.data(), width, scaled.data(), width);
+    scaled.assign(c4, c4 + c4_len);
+    scaled.resize(width, 0);
+    mulSmallLimbs(scaled.data(), width, 16);
+    subLimbs(c1_4c3.data(), width, scaled.data(), width);
+    divSmallLimbs(c1_4c3.data(), width, 2);
+
+    std::vector<Limb>& c3 = c1_4c3;
+    subLimbs(c3.data(), width, odd.data(), width);
+    divSmallLimbs(c3.data(), width, 3);
+    std::vector<Limb>& c1 = odd;
+    subLimbs(c1.data(), width, c3.data(), width);
+
+    addLimbs(out + k, n + m - k, c1.data(), trimLimbs(c1.data(), width));
+    addLimbs(out + 2 * k, n + m - 2 * k, c2.data(), trimLimbs(c2.data(), width));
+    addLimbs(out + 3 * k, n + m - 3 * k, c3.data(), trimLimbs(c3.data(), width));
+}
+
+template <unsigned Mod>
+unsigned BigInteger::nttPow(unsigned long long base, unsigned long long exp) {
+    unsigned long long result = 1;
+    base %= Mod;
+    while (exp > 0) {
+        if (exp & 1) {
+            result = result * base % Mod;
+        }
+        base = base * base % Mod;
+        exp >>= 1;
+    }
+    return static_cast<unsigned>(result);
+}
+
+// In-place forward transform; a.size() is a power of two not above kNttMaxLength_.
+// All three primes are c * 2^k + 1 with primitive root 3, so 3^(Mod >> s) has order 2^s.
+template <unsigned Mod>
+void BigInteger::ntt(std::vector<unsigned>& a) {
+    size_t n = a.size();
+    std::vector<unsigned> roots(std::max<size_t>(n, 2), 1);
+    for (size_t k = 2, s = 2; k < n; k *= 2, ++s) {
+        unsigned long long z = nttPow<Mod>(3, Mod >> s);
+        for (size_t i = k; i < 2 * k; ++i) {
+            roots[i] = (i & 1) ? static_cast<unsigned>(roots[i / 2] * z % Mod) : roots[i / 2];
+        }
+    }
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(a[i], a[j]);
+        }
+    }
+    for (size_t k = 1; k < n; k *= 2) {
+        for (size_t i = 0; i < n; i += 2 * k) {
+            for (size_t j = 0; j < k; ++j) {
+                unsigned z = static_cast<unsigned>(static_cast<unsigned long long>(roots[j + k]) * a[i + j + k] % Mod);
+                unsigned& low = a[i + j];
+                a[i + j + k] = low - z + (z > low ? Mod : 0);
+                low = (low + z >= Mod) ? low + z - Mod : low + z;
+            }
+        }
+    }
+}
+
+void BigInteger::splitNttChunks(const Limb* a, size_t n, std::vector<unsigned>& chunks) {
+    chunks.resize(n * kNttChunksPerLimb_);
+    for (size_t i = 0; i < n; ++i) {
+        DoubleLimb limb = a[i];
+        for (size_t c = 0; c < kNttChunksPerLimb_; ++c) {
+            chunks[i * kNttChunksPerLimb_ + c] = static_cast<unsigned>(limb % kNttChunkBase_);
+            limb /= kNttChunkBase_;
+        }
+    }
+}
+
+template <unsigned Mod>
+void BigInteger::nttConvolution(const std::vector<unsigned>& a, const std::vector<unsigned>& b,
+                                size_t size, std::vector<unsigned>& out) {
+    std::vector<unsigned> fa(size, 0), fb(size, 0);
+    for (size_t i = 0; i < a.size(); ++i) {
+        fa[i] = a[i] % Mod;
+    }
+    for (size_t i = 0; i < b.size(); ++i) {
+        fb[i] = b[i] % Mod;
+    }
+    forkJoin(true, [&] { ntt<Mod>(fa); }, [&] { ntt<Mod>(fb); });
+    unsigned long long inv_size = nttPow<Mod>(size, Mod - 2);
+    out.assign(size, 0);
+    for (size_t i = 0; i < size; ++i) {
+        unsigned long long product = static_cast<unsigned long long>(fa[i]) * fb[i] % Mod;
+        out[(size - i) & (size - 1)] = static_cast<unsigned>(product * inv_size % Mod);
+    }
+    ntt<Mod>(out);
+}
+
+// Limbs are cut into chunks below kNttChunkBase_ (a whole limb in base 10^9, two halves
+// of a binary limb). Each convolution coefficient is then below 2^22 * kNttChunkBase_^2,
+// which is under the product of the three primes, so CRT (Garner) recovers it exactly.
+void BigInteger::mulNtt(const Limb* a, size_t n, const Limb* b, size_t m, Limb* out) {
+    std::vector<unsigned> chunks_a, chunks_b;
+    splitNttChunks(a, n, chunks_a);
+    splitNttChunks(b, m, chunks_b);
+    size_t size = 1;
+    while (size < chunks_a.size() + chunks_b.size()) {
+        size <<= 1;
+    }
+    std::vector<unsigned> r1, r2, r3;
+    forkJoin(true,
+             [&] { nttConvolution<kNttPrime1_>(chunks_a, chunks_b, size, r1); },
+             [&] { nttConvolution<kNttPrime2_>(chunks_a, chunks_b, size, r2); },
+             [&] { nttConvolution<kNttPrime3_>(chunks_a, chunks_b, size, r3); });
+
+    const unsigned long long p1 = kNttPrime1_, p2 = kNttPrime2_, p3 = kNttPrime3_;
+    const unsigned long long p12 = p1 * p2;
+    const unsigned long long base = kNttChunkBase_;
+    const unsigned long long inv_p1 = nttPow<kNttPrime2_>(p1, p2 - 2);
+    const unsigned long long inv_p12 = nttPow<kNttPrime3_>(p12 % p3, p3 - 2);
+    unsigned long long carry = 0;
+    for (size_t i = 0; i < n + m; ++i) {
+        DoubleLimb limb = 0;
+        DoubleLimb scale = 1;
+        for (size_t c = 0; c < kNttChunksPerLimb_; ++c) {
+            size_t k = i * kNttChunksPerLimb_ + c;
+            unsigned long long t = (r2[k] + p2 - r1[k] % p2) % p2 * inv_p1 % p2;
+            unsigned long long x12 = r1[k] + p1 * t;
+            unsigned long long u = (r3[k] + p3 - x12 % p3) % p3 * inv_p12 % p3;
+            unsigned long long low = x12 % base + (p12 % base) * u + carry % base;
+            unsigned long long high = x12 / base + (p12 / base) * u + carry / base + low / base;
+            limb += (low % base) * scale;
+            scale *= base;
+            carry = high;
+        }
+        out[i] = static_cast<Limb>(limb);
+    }
+}
+
+BigInteger::ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+BigInteger::ThreadPool& BigInteger::threadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// Caps the threads used by one multiplication or product(), the caller's own included;
+// 1 keeps everything on the calling thread.
+void BigInteger::setThreadLimit(unsigned threads) {
+    ThreadPool& pool = threadPool();
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.limit = std::max(1u, threads);
+    }
+    pool.wake.notify_all();
+}
+
+void BigInteger::runTask(Fork& fork, size_t index) {
+    std::exception_ptr error;
+    try {
+        fork.tasks[index]();
+    } catch (...) {
+        error = std::current_exception();
+    }
+    ThreadPool& pool = threadPool();
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        if (error && !fork.error) {
+            fork.error = error;
+        }
+        ++fork.done;
+    }
+    pool.finished.notify_all();
+}
+
+// Worker index takes part while index + 1 < limit, so lowering the limit idles the rest.
+void BigInteger::workerLoop(size_t index) {
+    ThreadPool& pool = threadPool();
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    while (true) {
+        pool.wake.wait(lock, [&] { return pool.stopping || (!pool.forks.empty() && index + 1 < pool.limit); });
+        if (pool.stopping) {
+            return;
+        }
+        Fork* fork = pool.forks.front();
+        size_t task = fork->next.fetch_add(1);
+        if (task + 1 >= fork->count) {
+            pool.forks.pop_front();
+        }
+        if (task < fork->count) {
+            lock.unlock();
+            runTask(*fork, task);
+            lock.lock();
+        }
+    }
+}
+
+// Runs tasks[0] on the calling thread and queues the others for the pool. The caller then
+// claims whatever no worker has started, so a fork never waits on a queued task and nested
+// calls cannot deadlock; it waits only for tasks already running elsewhere. The first
+// exception thrown by any task is rethrown here once all of them have finished.
+void BigInteger::runParallel(std::function<void()>* tasks, size_t count) {
+    ThreadPool& pool = threadPool();
+    Fork fork{tasks, count};
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        while (pool.workers.size() + 1 < pool.limit) {
+            try {
+                pool.workers.emplace_back(workerLoop, pool.workers.size());
+            } catch (const std::system_error&) {
+                break;
+            }
+        }
+        pool.forks.push_back(&fork);
+    }
+    pool.wake.notify_all();
+    runTask(fork, 0);
+    for (size_t task = fork.next.fetch_add(1); task < count; task = fork.next.fetch_add(1)) {
+        runTask(fork, task);
+    }
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    auto queued = std::find(pool.forks.begin(), pool.forks.end(), &fork);
+    if (queued != pool.forks.end()) {
+        pool.forks.erase(queued);
+    }
+    pool.finished.wait(lock, [&] { return fork.done == count; });
+    if (fork.error) {
+        std::rethrow_exception(fork.error);
+    }
+}
+
+// Independent sub-products; parallel says whether they are large enough to pay for a thread.
+template <typename... Tasks>
+void BigInteger::forkJoin(bool parallel, Tasks&&... tasks) {
+    if (!parallel || threadPool().limit.load(std::memory_order_relaxed) <= 1) {
+        (tasks(), ...);
+        return;
+    }
+    std::function<void()> list[] = {std::function<void()>(tasks)...};
+    runParallel(list, sizeof...(tasks));
+}
+
+// out[0..n + m) = a[0..n) * b[0..m); out must not overlap the operands.
+void BigInteger::mulLimbs(const Limb* a, size_t n, const Limb* b, size_t m, Limb* out) {
+    size_t total = n + m;
+    n = trimLimbs(a, n);
+    m = trimLimbs(b, m);
+    if (n < m) {
+        std::swap(a, b);
+        std::swap(n, m);
+    }
+    std::fill(out + n + m, out + total, 0);
+    if (m == 0) {
+        std::fill(out, out + n, 0);
+    } else if (m >= kNttThreshold_ && (n + m) * kNttChunksPerLimb_ <= kNttMaxLength_) {
+        mulNtt(a, n, b, m, out);
+    } else if (m < kKaratsubaThreshold_) {
+        mulSchoolbook(a, n, b, m, out);
+    } else if (m <= (n + 1) / 2) {
+        mulUnbalanced(a, n, b, m, out);
+    } else if (m < kToom3Threshold_) {
+        mulKaratsuba(a, n, b, m, out);
+    } else {
+        mulToom3(a, n, b, m, out);
+    }
+}
+
+BigInteger& BigInteger::operator*=(const BigInteger& other) {
+    assignProduct(*this, other);
+    return *this;
+}
+
+// Product of values[first, last), where limbs holds prefix sums of the limb counts. The range
+// is cut where half of its limbs lie on each side, so the two halves have about the same size
+// whatever the sizes of the factors, and large halves are computed on separate threads.
+void BigInteger::productRange(BigInteger* values, const size_t* limbs, size_t first, size_t last,
+                              BigInteger& result) {
+    size_t total = limbs[last] - limbs[first];
+    if (last - first == 1 || total <= kKaratsubaThreshold_) {
+        result = std::move(values[first]);
+        for (size_t i = first + 1; i < last; ++i) {
+            result *= values[i];
+        }
+        return;
+    }
+    size_t middle = std::lower_bound(limbs + first + 1, limbs + last, limbs[first] + total / 2) - limbs;
+    middle = std::min(middle, last - 1);
+    BigInteger right;
+    forkJoin(total >= 2 * kParallelLimbs_,
+             [&] { productRange(values, limbs, first, middle, result); },
+             [&] { productRange(values, limbs, middle, last, right); });
+    result *= right;
+}
+
+// a and b may alias *this: the product then goes to a separate buffer, otherwise into the
+// existing limbs when they have room. One spare limb is kept so that a following += does not
+// reallocate.
+void BigInteger::assignProduct(const BigInteger& a, const BigInteger& b) {
+    bool negative = (a.is_negative_ != b.is_negative_);
+    size_t n = a.digits_.size() + b.digits_.size();
+    if (n <= kStackProductLimbs_) {
+        Limb result[kStackProductLimbs_];
+        mulLimbs(a.digits_.data(), a.digits_.size(), b.digits_.data(), b.digits_.size(), result);
+        assignLimbs(result, n, negative);
+        return;
+    }
+    if (&a != this && &b != this && digits_.capacity() > n) {
+        digits_.resize(n);
+        mulLimbs(a.digits_.data(), a.digits_.size(), b.digits_.data(), b.digits_.size(), digits_.data());
+        digits_.resize(std::max<size_t>(1, trimLimbs(digits_.data(), n)));
+        is_negative_ = negative && (digits_.size() > 1 || digits_[0] != 0);
+        return;
+    }
+    LimbVector result;
+    result.reserve(n + 1);
+    result.resize(n);
+    mulLimbs(a.digits_.data(), a.digits_.size(), b.digits_.data(), b.digits_.size(), result.data());
+    result.resize(std::max<size_t>(1, trimLimbs(result.data(), n)));
+    digits_.swap(result);
+    is_negative_ = negative && (digits_.size() > 1 || digits_[0] != 0);
+}
+
+void BigInteger::assignLimbs(const Limb* limbs, size_t n, bool negative) {
+    n = trimLimbs(limbs, n);
+    if (n == 0) {
+        digits_.assign(1, 0);
+    } else {
+        digits_.assign(limbs, limbs + n);
+    }
+    is_negative_ = negative && n > 0;
+}
+
+bool BigInteger::toSmall(const Limb* a, size_t n, unsigned __int128& value) {
+    n = trimLimbs(a, n);
+    if (n > kInlineLimbs_) {
+        return false;
+    }
+    value = 0;
+    for (size_t i = n; i > 0; --i) {
+        if (__builtin_mul_overflow(value, static_cast<unsigned __int128>(kBase_), &value) ||
+            __builtin_add_overflow(value, static_cast<unsigned __int128>(a[i - 1]), &value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BigInteger::assignSmall(unsigned __int128 value, bool negative) {
+    is_negative_ = negative && value != 0;
+    digits_.clear();
+    do {
+        digits_.push_back(static_cast<Limb>(value % static_cast<unsigned __int128>(kBase_)));
+        value /= static_cast<unsigned __int128>(kBase_);
+    } while (value != 0);
+}
+
+// Knuth, TAOCP vol. 2, 4.3.1, Algorithm D; requires un >= vn >= 2 and v[vn - 1] != 0.
+void BigInteger::divKnuth(const Limb* u, size_t un, const Limb* v, size_t vn,
+                          std::vector<Limb>& quotient, std::vector<Limb>& remainder) {
+    Limb factor = static_cast<Limb>(kBase_ / (static_cast<DoubleLimb>(v[vn - 1]) + 1));
+    std::vector<Limb> a(u, u + un), b(v, v + vn);
+    a.push_back(mulSmallLimbs(a.data(), un, factor));
+    mulSmallLimbs(b.data(), vn, factor);
+    quotient.assign(un - vn + 1, 0);
+    const DoubleLimb top = b[vn - 1];
+    const DoubleLimb second = b[vn - 2];
+    for (size_t j = un - vn + 1; j-- > 0;) {
+        DoubleLimb numerator = a[j + vn] * kBase_ + a[j + vn - 1];
+        DoubleLimb q_hat = numerator / top;
+        DoubleLimb r_hat = numerator % top;
+        while (q_hat >= kBase_ || q_hat * second > r_hat * kBase_ + a[j + vn - 2]) {
+            --q_hat;
+            r_hat += top;
+            if (r_hat >= kBase_) {
+                break;
+            }
+        }
+        DoubleLimb carry = 0;
+        Limb borrow = 0;
+        for (size_t i = 0; i < vn; ++i) {
+            DoubleLimb product = q_hat * b[i] + carry;
+            carry = product / kBase_;
+            DoubleLimb deduction = product % kBase_ + borrow;
+            borrow = (a[i + j] < deduction) ? 1 : 0;
+            a[i + j] = static_cast<Limb>(a[i + j] + borrow * kBase_ - deduction);
+        }
+        DoubleLimb deduction = carry + borrow;
+        if (a[j + vn] < deduction) {
+            a[j + vn] = static_cast<Limb>(a[j + vn] + kBase_ - deduction);
+            addLimbs(a.data() + j, vn + 1, b.data(), vn);
+            --q_hat;
+        } else {
+            a[j + vn] = static_cast<Limb>(a[j + vn] - deduction);
+        }
+        quotient[j] = static_cast<Limb>(q_hat);
+    }
+    divSmallLimbs(a.data(), vn, factor);
+    remainder.assign(a.begin(), a.begin() + vn);
+}
+
+// Burnikel-Ziegler: a has 2n limbs, b has n limbs with its top limb >= kBase_ / 2 and
+// a < b * kBase_^n. Produces an n-limb quotient and an n-limb remainder.
+void BigInteger::div2n1n(const Limb* a, const Limb* b, size_t n,
+                         std::vector<Limb>& quotient, std::vector<Limb>& remainder) {
+    if (n % 2 != 0 || n <= kBurnikelZieglerThreshold_) {
+        divKnuth(a, 2 * n, b, n, quotient, remainder);
+        quotient.resize(n, 0);
+        remainder.resize(n, 0);
+        return;
+    }
+    size_t half = n / 2;
+    std::vector<Limb> high, low, rest;
+    div3n2n(a + half, b, half, high, rest);
+    rest.insert(rest.begin(), a, a + half);
+    div3n2n(rest.data(), b, half, low, remainder);
+    quotient.swap(low);
+    quotient.insert(quotient.end(), high.begin(), high.end());
+}
+
+// a has 3 * half limbs, b has 2 * half limbs (normalized) and a < b * kBase_^half.
+void BigInteger::div3n2n(const Limb* a, const Limb* b, size_t half,
+                         std::vector<Limb>& quotient, std::vector<Limb>& remainder) {
+    const Limb* b_high = b + half;
+    std::vector<Limb> partial(2 * half + 2, 0);
+    if (compareLimbs(a + 2 * half, half, b_high, half) < 0) {
+        std::vector<Limb> high_rem;
+        div2n1n(a + half, b_high, half, quotient, high_rem);
+        std::copy(high_rem.begin(), high_rem.end(), partial.begin() + half);
+    } else {
+        // quotient = kBase_^half - 1, high remainder = [a1 a2] - b_high * kBase_^half + b_high
+        quotient.assign(half, static_cast<Limb>(kBase_ - 1));
+        std::vector<Limb> high_rem(a + half, a + 3 * half);
+        subLimbs(high_rem.data() + half, half, b_high, half);
+        high_rem.push_back(addLimbs(high_rem.data(), 2 * half, b_high, half));
+        std::copy(high_rem.begin(), high_rem.begin() + half + 2, partial.begin() + half);
+    }
+    std::copy(a, a + half, partial.begin());
+
+    std::vector<Limb> deduction(2 * half);
+    mulLimbs(quotient.data(), half, b, half, deduction.data());
+    while (compareLimbs(partial.data(), partial.size(), deduction.data(), deduction.size()) < 0) {
+        addLimbs(partial.data(), partial.size(), b, 2 * half);
+        std::vector<Limb> one(1, 1);
+        subLimbs(quotient.data(), half, one.data(), 1);
+    }
+    subLimbs(partial.data(), partial.size(), deduction.data(), deduction.size());
+    remainder.assign(partial.begin(), partial.begin() + 2 * half);
+}
+
+void BigInteger::divBurnikelZiegler(const Limb* u, size_t un, const Limb* v, size_t vn,
+                                    std::vector<Limb>& quotient, std::vector<Limb>& remainder) {
+    size_t blocks = 1;
+    while (blocks * kBurnikelZieglerThreshold_ < vn) {
+        blocks *= 2;
+    }
+    size_t n = (vn + blocks - 1) / blocks * blocks;
+    size_t shift = n - vn;
+    Limb factor = static_cast<Limb>(kBase_ / (static_cast<DoubleLimb>(v[vn - 1]) + 1));
+
+    std::vector<Limb> b(n, 0);
+    std::copy(v, v + vn, b.begin() + shift);
+    mulSmallLimbs(b.data() + shift, vn, factor);
+    size_t t = std::max<size_t>(2, (un + shift + 2 + n - 1) / n);
+    std::vector<Limb> a(t * n, 0);
+    std::copy(u, u + un, a.begin() + shift);
+    a[un + shift] = mulSmallLimbs(a.data() + shift, un, factor);
+
+    quotient.assign((t - 1) * n, 0);
+    std::vector<Limb> window(a.end() - 2 * n, a.end()), block_quotient;
+    for (size_t i = t - 1; i-- > 0;) {
+        div2n1n(window.data(), b.data(), n, block_quotient, remainder);
+        std::copy(block_quotient.begin(), block_quotient.end(), quotient.begin() + i * n);
+        if (i > 0) {
+            std::copy(a.begin() + (i - 1) * n, a.begin() + i * n, window.begin());
+            std::copy(remainder.begin(), remainder.end(), window.begin() + n);
+        }
+    }
+    remainder.erase(remainder.begin(), remainder.begin() + shift);
+    divSmallLimbs(remainder.data(), remainder.size(), factor);
+}
+
+void BigInteger::divmodLimbs(const Limb* u, size_t un, const Limb* v, size_t vn,
+                             std::vector<Limb>& quotient, std::vector<Limb>& remainder) {
+    un = trimLimbs(u, un);
+    vn = trimLimbs(v, vn);
+    if (un < vn) {
+        quotient.assign(1, 0);
+        remainder.assign(u, u + un);
+    } else if (vn == 1) {
+        quotient.assign(u, u + un);
+        remainder.assign(1, divSmallLimbs(quotient.data(), un, v[0]));
+    } else if (vn < kBurnikelZieglerThreshold_ || un - vn < kBurnikelZieglerThreshold_) {
+        divKnuth(u, un, v, vn, quotient, remainder);
+    } else {
+        divBurnikelZiegler(u, un, v, vn, quotient, remainder);
+    }
+}
+
+void divmod(const BigInteger& dividend, const BigInteger& divisor,
+            BigInteger& quotient, BigInteger& remainder) {
+    if (BigInteger::trimLimbs(divisor.digits_.data(), divisor.digits_.size()) == 0) {
+        throw std::domain_error("BigInteger division by zero");
+    }
+    bool q_negative = (dividend.is_negative_ != divisor.is_negative_);
+    bool r_negative = dividend.is_negative_;
+    unsigned __int128 u, v;
+    if (BigInteger::toSmall(dividend.digits_.data(), dividend.digits_.size(), u) &&
+        BigInteger::toSmall(divisor.digits_.data(), divisor.digits_.size(), v)) {
+        quotient.assignSmall(u / v, q_negative);
+        remainder.assignSmall(u % v, r_negative);
+        return;
+    }
+    std::vector<BigInteger::Limb> q, r;
+    BigInteger::divmodLimbs(dividend.digits_.data(), dividend.digits_.size(),
+                            divisor.digits_.data(), divisor.digits_.size(), q, r);
+    quotient.assignLimbs(q.data(), q.size(), q_negative);
+    remainder.assignLimbs(r.data(), r.size(), r_negative);
 }
 
 BigInteger& BigInteger::operator/=(const BigInteger& other) {
-    bool res_is_negative = (is_negative_ != other.is_negative());
-    is_negative_ = false;
-    BigInteger support = 0, result;
-    if ((digits_.empty() == 1) || (other.data().empty() == 1) || (*this < other)) {
-        *this = support;
+    BigInteger remainder;
+    divmod(*this, other, *this, remainder);
+    return *this;
+}
+
+BigInteger& BigInteger::operator%=(const BigInteger& other) {
+    BigInteger quotient;
+    divmod(*this, other, quotient, *this);
+    return *this;
+}
+
+// out[0..n) = u * a[0..n) - v * b[0..n), which must lie in [0, kBase_^n); out may alias a or b.
+void BigInteger::combineLimbs(Limb* out, const Limb* a, Limb u, const Limb* b, Limb v, size_t n) {
+    DoubleLimb carry_a = 0, carry_b = 0;
+    Limb borrow = 0;
+    for (size_t i = 0; i < n; ++i) {
+        DoubleLimb x = static_cast<DoubleLimb>(u) * a[i] + carry_a;
+        DoubleLimb y = static_cast<DoubleLimb>(v) * b[i] + carry_b;
+        carry_a = x / kBase_;
+        carry_b = y / kBase_;
+        DoubleLimb low = x % kBase_;
+        DoubleLimb deduction = y % kBase_ + borrow;
+        borrow = (low < deduction) ? 1 : 0;
+        out[i] = static_cast<Limb>(low + borrow * kBase_ - deduction);
+    }
+}
+
+unsigned __int128 BigInteger::binaryGcd(unsigned __int128 a, unsigned __int128 b) {
+    auto trailingZeros = [](unsigned __int128 x) {
+        unsigned long long low = static_cast<unsigned long long>(x);
+        return (low != 0) ? __builtin_ctzll(low)
+                          : 64 + __builtin_ctzll(static_cast<unsigned long long>(x >> 64));
+    };
+    if (a == 0 || b == 0) {
+        return a | b;
+    }
+    int shift = trailingZeros(a | b);
+    a >>= trailingZeros(a);
+    do {
+        b >>= trailingZeros(b);
+        if (a > b) {
+            std::swap(a, b);
+        }
+        b -= a;
+    } while (b != 0);
+    return a << shift;
+}
+
+// (a, b) = (b, a mod b).
+void BigInteger::divisionStep(BigInteger& a, BigInteger& b, BigInteger* cofactors) {
+    BigInteger quotient, remainder;
+    divmod(a, b, quotient, remainder);
+    swap(a, b);
+    swap(b, remainder);
+    if (cofactors != nullptr) {
+        for (int j = 0; j < 2; ++j) {
+            cofactors[j] -= quotient * cofactors[2 + j];
+            swap(cofactors[j], cofactors[2 + j]);
+        }
+    }
+}
+
+// One Lehmer step (Knuth's Algorithm L): run Euclid on the leading two limbs of a and b
+// while both bracketing quotients agree, then apply the collected cofactors to the full
+// numbers in a single pass. Falls back to a division step when no quotient is certain.
+void BigInteger::lehmerStep(BigInteger& a, BigInteger& b, BigInteger* cofactors,
+                            LimbVector* scratch) {
+    size_t n = a.digits_.size();
+    if (n < 2 || b.digits_.size() + 1 < n) {
+        divisionStep(a, b, cofactors);
+        return;
+    }
+    b.digits_.resize(n, 0);
+    SignedDoubleLimb ah, bh;
+#ifdef BIGINTEGER_BINARY_LIMBS
+    // floor(x / 2^e) with e chosen so that the leading part of a has 126 bits.
+    size_t bits = 64 * n - __builtin_clzll(a.digits_[n - 1]);
+    size_t e = (bits > 126) ? bits - 126 : 0;
+    auto leading = [&](const Limb* x) {
+        size_t k = e / 64, offset = e % 64;
+        Limb mid = (k + 1 < n) ? x[k + 1] : 0, high = (k + 2 < n) ? x[k + 2] : 0;
+        unsigned __int128 value = ((static_cast<unsigned __int128>(mid) << 64) | x[k]) >> offset;
+        if (offset != 0) {
+            value |= static_cast<unsigned __int128>(high) << (128 - offset);
+        }
+        return static_cast<SignedDoubleLimb>(value);
+    };
+    ah = leading(a.digits_.data());
+    bh = leading(b.digits_.data());
+#else
+    ah = static_cast<SignedDoubleLimb>(a.digits_[n - 1]) * kBase_ + a.digits_[n - 2];
+    bh = static_cast<SignedDoubleLimb>(b.digits_[n - 1]) * kBase_ + b.digits_[n - 2];
+#endif
+    SignedDoubleLimb A = 1, B = 0, C = 0, D = 1;
+    while (bh + C > 0 && bh + D > 0) {
+        SignedDoubleLimb q = (ah + A) / (bh + C);
+        if (q != (ah + B) / (bh + D)) {
+            break;
+        }
+        SignedDoubleLimb next_c = A - q * C, next_d = B - q * D;
+        if (next_c > kLehmerCofactorBound_ || -next_c > kLehmerCofactorBound_ ||
+            next_d > kLehmerCofactorBound_ || -next_d > kLehmerCofactorBound_) {
+            break;
+        }
+        A = C;
+        B = D;
+        C = next_c;
+        D = next_d;
+        SignedDoubleLimb r = ah - q * bh;
+        ah = bh;
+        bh = r;
+    }
+    if (B == 0) {
+        b.popZeros();
+        divisionStep(a, b, cofactors);
+        return;
+    }
+    // Each row of [A B; C D] has one non-negative and one non-positive entry.
+    auto row = [&](LimbVector& out, SignedDoubleLimb x, SignedDoubleLimb y) {
+        out.resize(n);
+        if (y <= 0) {
+            combineLimbs(out.data(), a.digits_.data(), static_cast<Limb>(x),
+                         b.digits_.data(), static_cast<Limb>(-y), n);
+        } else {
+            combineLimbs(out.data(), b.digits_.data(), static_cast<Limb>(y),
+                         a.digits_.data(), static_cast<Limb>(-x), n);
+        }
+        out.resize(std::max<size_t>(1, trimLimbs(out.data(), n)));
+    };
+    row(scratch[0], A, B);
+    row(scratch[1], C, D);
+    a.digits_.swap(scratch[0]);
+    b.digits_.swap(scratch[1]);
+    if (cofactors != nullptr) {
+        for (int j = 0; j < 2; ++j) {
+            BigInteger first = cofactors[j] * static_cast<long long>(A) +
+                               cofactors[2 + j] * static_cast<long long>(B);
+            cofactors[2 + j] = cofactors[j] * static_cast<long long>(C) +
+                               cofactors[2 + j] * static_cast<long long>(D);
+            swap(cofactors[j], first);
+        }
+    }
+}
+
+// Reduces until b has at most s limbs. Above kHalfGcdThreshold_ the cofactors are found
+// recursively from the limbs above s, reduced to half their length, and applied to the full
+// numbers at once; a matrix that the discarded low limbs invalidate is rejected in favour of
+// a Lehmer step, so only the speed depends on the approximation.
+void BigInteger::halfGcd(BigInteger& a, BigInteger& b, size_t s, BigInteger* cofactors,
+                         LimbVector* scratch) {
+    while (b.digits_.size() > s && (b.digits_.size() > 1 || b.digits_[0] != 0)) {
+        size_t n = a.digits_.size();
+        if (n - s < kHalfGcdThreshold_ || b.digits_.size() + 1 < n) {
+            lehmerStep(a, b, cofactors, scratch);
+            continue;
+        }
+        BigInteger top_a, top_b, step[4] = {1, 0, 0, 1};
+        top_a.assignLimbs(a.digits_.data() + s, n - s, false);
+        top_b.assignLimbs(b.digits_.data() + s, b.digits_.size() - s, false);
+        halfGcd(top_a, top_b, (n - s) / 2 + 1, step, scratch);
+        BigInteger next_a = step[0] * a + step[1] * b;
+        BigInteger next_b = step[2] * a + step[3] * b;
+        if (step[1] == 0 || next_b.is_negative() || next_a < next_b || !(next_b < b)) {
+            lehmerStep(a, b, cofactors, scratch);
+            continue;
+        }
+        swap(a, next_a);
+        swap(b, next_b);
+        if (cofactors != nullptr) {
+            for (int j = 0; j < 2; ++j) {
+                BigInteger first = step[0] * cofactors[j] + step[1] * cofactors[2 + j];
+                cofactors[2 + j] = step[2] * cofactors[j] + step[3] * cofactors[2 + j];
+                swap(cofactors[j], first);
+            }
+        }
+    }
+}
+
+// Runs a >= b >= 0 down to (gcd, 0). Without cofactors the tail that fits in 128 bits is
+// finished by binary GCD.
+void BigInteger::reduceGcd(BigInteger& a, BigInteger& b, BigInteger* cofactors) {
+    LimbVector scratch[2];
+    unsigned __int128 x, y;
+    while (b.digits_.size() > 1 || b.digits_[0] != 0) {
+        if (cofactors == nullptr && toSmall(b.digits_.data(), b.digits_.size(), y)) {
+            if (toSmall(a.digits_.data(), a.digits_.size(), x)) {
+                a.assignSmall(binaryGcd(x, y), false);
+                b.assignSmall(0, false);
+                return;
+            }
+            divisionStep(a, b, cofactors);
+        } else if (b.digits_.size() >= kHalfGcdThreshold_ &&
+                   2 * b.digits_.size() > a.digits_.size()) {
+            halfGcd(a, b, a.digits_.size() / 2, cofactors, scratch);
+        } else {
+            lehmerStep(a, b, cofactors, scratch);
+        }
+    }
+}
+
+BigInteger GCD(const BigInteger& first, const BigInteger& second) {
+    BigInteger a = first, b = second;
+    a.is_negative_ = false;
+    b.is_negative_ = false;
+    if (a < b) {
+        swap(a, b);
+    }
+    BigInteger::reduceGcd(a, b, nullptr);
+    return a;
+}
+
+// Returns g = gcd(first, second) >= 0 and sets first * x + second * y = g, with
+// 0 <= x < |second| / g when second != 0.
+BigInteger extendedGCD(const BigInteger& first, const BigInteger& second,
+                       BigInteger& x, BigInteger& y) {
+    BigInteger a = first, b = second;
+    a.is_negative_ = false;
+    b.is_negative_ = false;
+    BigInteger cofactors[4] = {1, 0, 0, 1};
+    if (a < b) {
+        swap(a, b);
+        swap(cofactors[0], cofactors[2]);
+        swap(cofactors[1], cofactors[3]);
+    }
+    BigInteger::reduceGcd(a, b, cofactors);
+    x = cofactors[0];
+    y = cofactors[1];
+    if (a == 0) {
+        return a;
+    }
+    BigInteger abs_first = first, abs_second = second;
+    abs_first.is_negative_ = false;
+    abs_second.is_negative_ = false;
+    if (abs_second != 0) {
+        BigInteger period = abs_second / a;
+        x %= period;
+        if (x.is_negative()) {
+            x += period;
+        }
+        y = (a - abs_first * x) / abs_second;
+    }
+    if (first.is_negative()) {
+        x.negate();
+    }
+    if (second.is_negative()) {
+        y.negate();
+    }
+    return a;
+}
+
+void BigInteger::wordPowers(size_t levels, std::vector<BigInteger>& powers) {
+    powers.assign(1, BigInteger());
+    powers[0].assignSmall(static_cast<unsigned __int128>(1) << 64, false);
+    while (powers.size() < levels) {
+        powers.push_back(powers.back() * powers.back());
+    }
+}
+
+// out[0, 2^level) = value < 2^(64 2^level), split at powers[level - 1]. Up to
+// kWordBaseLevel_ the words are peeled off 16 bits at a time with single-limb divisions.
+void BigInteger::decimalToWords(const BigInteger& value, const std::vector<BigInteger>& powers, size_t level,
+                                Word* out) {
+    if (level <= kWordBaseLevel_) {
+        BigInteger rest = value;
+        size_t pieces = size_t(4) << level;
+        for (size_t i = 0; i < pieces && !(rest == 0); ++i) {
+            Word piece = static_cast<Word>(divSmallLimbs(rest.digits_.data(), rest.digits_.size(), Limb(1) << 16));
+            rest.digits_.resize(std::max<size_t>(trimLimbs(rest.digits_.data(), rest.digits_.size()), 1));
+            out[i / 4] |= piece << (16 * (i % 4));
+        }
+        return;
+    }
+    BigInteger high, low;
+    divmod(value, powers[level - 1], high, low);
+    size_t half = size_t(1) << (level - 1);
+    decimalToWords(low, powers, level - 1, out);
+    decimalToWords(high, powers, level - 1, out + half);
+}
+
+BigInteger BigInteger::wordsToDecimal(const Word* words, const std::vector<BigInteger>& powers, size_t level) {
+    BigInteger value;
+    if (level <= kWordBaseLevel_) {
+        for (size_t i = size_t(4) << level; i > 0; --i) {
+            Limb carry = mulSmallLimbs(value.digits_.data(), value.digits_.size(), Limb(1) << 16);
+            if (carry != 0) {
+                value.digits_.push_back(carry);
+            }
+            value += static_cast<long long>((words[(i - 1) / 4] >> (16 * ((i - 1) % 4))) & 0xffff);
+        }
+        return value;
+    }
+    size_t half = size_t(1) << (level - 1);
+    value = wordsToDecimal(words + half, powers, level - 1);
+    if (value != 0) {
+        value *= powers[level - 1];
+    }
+    value += wordsToDecimal(words, powers, level - 1);
+    return value;
+}
+
+void BigInteger::toWords(std::vector<Word>& words) const {
+#ifdef BIGINTEGER_BINARY_LIMBS
+    words.assign(digits_.begin(), digits_.end());
+#else
+    size_t count = static_cast<size_t>(bit_length() + 63) / 64;
+    size_t level = 0;
+    while ((size_t(1) << level) < count) {
+        ++level;
+    }
+    std::vector<BigInteger> powers;
+    wordPowers(level, powers);
+    words.assign(size_t(1) << level, 0);
+    BigInteger magnitude = *this;
+    magnitude.is_negative_ = false;
+    decimalToWords(magnitude, powers, level, words.data());
+    words.resize(std::max<size_t>(count, 1));
+#endif
+}
+
+void BigInteger::assignWords(const Word* words, size_t n, bool negative) {
+    while (n > 1 && words[n - 1] == 0) {
+        --n;
+    }
+#ifdef BIGINTEGER_BINARY_LIMBS
+    assignLimbs(words, n, negative);
+#else
+    size_t level = 0;
+    while ((size_t(1) << level) < n) {
+        ++level;
+    }
+    std::vector<BigInteger> powers;
+    wordPowers(level, powers);
+    std::vector<Word> padded(words, words + n);
+    padded.resize(size_t(1) << level, 0);
+    *this = wordsToDecimal(padded.data(), powers, level);
+    if (negative) {
+        negate();
+    }
+#endif
+}
+
+// Both operands in two's complement one word wider than either magnitude, so the top word
+// holds the sign.
+BigInteger& BigInteger::bitwiseAssign(const BigInteger& other, char op) {
+    std::vector<Word> a, b;
+    toWords(a);
+    other.toWords(b);
+    size_t n = std::max(a.size(), b.size()) + 1;
+    a.resize(n, 0);
+    b.resize(n, 0);
+    auto complement = [n](std::vector<Word>& words) {
+        bool carry = true;
+        for (size_t i = 0; i < n; ++i) {
+            words[i] = ~words[i] + carry;
+            carry = carry && words[i] == 0;
+        }
+    };
+    if (is_negative_) {
+        complement(a);
+    }
+    if (other.is_negative_) {
+        complement(b);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        a[i] = (op == '&') ? (a[i] & b[i]) : (op == '|') ? (a[i] | b[i]) : (a[i] ^ b[i]);
+    }
+    bool negative = (a[n - 1] >> 63) != 0;
+    if (negative) {
+        complement(a);
+    }
+    assignWords(a.data(), n, negative);
+    return *this;
+}
+
+BigInteger& BigInteger::operator&=(const BigInteger& other) {
+    return bitwiseAssign(other, '&');
+}
+
+BigInteger& BigInteger::operator|=(const BigInteger& other) {
+    return bitwiseAssign(other, '|');
+}
+
+BigInteger& BigInteger::operator^=(const BigInteger& other) {
+    return bitwiseAssign(other, '^');
+}
+
+// ~x = -x - 1 in two's complement.
+BigInteger BigInteger::operator~() const {
+    BigInteger value = -*this;
+    value -= 1;
+    return value;
+}
+
+// Binary limbs move words and bits in one pass. Decimal limbs shift by single-limb
+// multiplications (divisions for >>=) of up to 2^29 while shift is at most kSmallShiftBits_,
+// and otherwise multiply (divide) by 2^shift once.
+BigInteger& BigInteger::operator<<=(size_t shift) {
+    if (shift == 0 || (digits_.size() == 1 && digits_[0] == 0)) {
+        return *this;
+    }
+#ifdef BIGINTEGER_BINARY_LIMBS
+    size_t limbs = shift / 64, bits = shift % 64, n = digits_.size();
+    LimbVector shifted(n + limbs + 1, 0);
+    for (size_t i = 0; i < n; ++i) {
+        shifted[i + limbs] |= digits_[i] << bits;
+        if (bits != 0) {
+            shifted[i + limbs + 1] = digits_[i] >> (64 - bits);
+        }
+    }
+    shifted.resize(trimLimbs(shifted.data(), shifted.size()));
+    digits_.swap(shifted);
+#else
+    if (shift > kSmallShiftBits_) {
+        *this *= powerOfTwo(shift);
+        return *this;
+    }
+    for (; shift > 0; shift -= std::min<size_t>(shift, 29)) {
+        Limb factor = static_cast<Limb>(1) << std::min<size_t>(shift, 29);
+        Limb carry = mulSmallLimbs(digits_.data(), digits_.size(), factor);
+        if (carry != 0) {
+            digits_.push_back(carry);
+        }
+    }
+#endif
+    return *this;
+}
+
+// Arithmetic shift: rounds toward minus infinity, so negative values whose shifted-out bits
+// are not all zero move one further away from zero.
+BigInteger& BigInteger::operator>>=(size_t shift) {
+    if (shift == 0) {
         return *this;
     }
-    for (int i = static_cast<int>(digits_.size()); i > 0; --i) {
-        support *= kBase_;
-        support += digits_[i - 1];
-        if (support >= other) {
-            int left = 0;
-            int right = kBase_;
-            while (right - left > 1) {
-                int mid = (right + left) >> 1;
-                (other.is_negative_) ? (mid * (-other) <= support) ? left = mid : right = mid : (mid * other <= support) ? left = mid : right = mid;
+    bool inexact;
+#ifdef BIGINTEGER_BINARY_LIMBS
+    size_t limbs = shift / 64, bits = shift % 64, n = digits_.size();
+    if (limbs >= n) {
+        inexact = true;
+        digits_.assign(1, 0);
+    } else {
+        inexact = false;
+        for (size_t i = 0; i < limbs; ++i) {
+            inexact |= (digits_[i] != 0);
+        }
+        inexact |= bits != 0 && (digits_[limbs] << (64 - bits)) != 0;
+        for (size_t i = limbs; i < n; ++i) {
+            Limb high = (bits != 0 && i + 1 < n) ? digits_[i + 1] << (64 - bits) : 0;
+            digits_[i - limbs] = (digits_[i] >> bits) | high;
+        }
+        digits_.resize(std::max<size_t>(trimLimbs(digits_.data(), n - limbs), 1));
+    }
+#else
+    if (shift <= kSmallShiftBits_) {
+        inexact = false;
+        for (; shift > 0; shift -= std::min<size_t>(shift, 29)) {
+            Limb divisor = static_cast<Limb>(1) << std::min<size_t>(shift, 29);
+            inexact |= divSmallLimbs(digits_.data(), digits_.size(), divisor) != 0;
+            digits_.resize(std::max<size_t>(trimLimbs(digits_.data(), digits_.size()), 1));
+        }
+    } else {
+        BigInteger quotient, remainder;
+        bool negative = is_negative_;
+        is_negative_ = false;
+        divmod(*this, powerOfTwo(shift), quotient, remainder);
+        inexact = !(remainder == 0);
+        *this = std::move(quotient);
+        is_negative_ = negative;
+    }
+#endif
+    if (digits_.size() == 1 && digits_[0] == 0) {
+        is_negative_ = is_negative_ && inexact;
+        if (is_negative_) {
+            digits_[0] = 1;
+        }
+        return *this;
+    }
+    if (is_negative_ && inexact) {
+        is_negative_ = false;
+        *this += 1;
+        is_negative_ = true;
+    }
+    return *this;
+}
+
+// Length of |x| in bits. Decimal limbs read it off log2 of the top three limbs and only
+// compare against a power of two when that lands within 1e-5 of an integer.
+size_t BigInteger::bit_length() const {
+    size_t n = digits_.size();
+    if (n == 1 && digits_[0] == 0) {
+        return 0;
+    }
+    if (kBinaryLimbs_) {
+        return static_cast<size_t>(bitLengthEstimate(*this));
+    }
+    size_t used = std::min<size_t>(n, 3);
+    double top = 0;
+    for (size_t i = n; i > n - used; --i) {
+        top = top * static_cast<double>(kBase_) + static_cast<double>(digits_[i - 1]);
+    }
+    double bits = std::log2(top) + static_cast<double>(n - used) * std::log2(static_cast<double>(kBase_));
+    double fraction = bits - std::floor(bits);
+    if (fraction > 1e-5 && fraction < 1 - 1e-5) {
+        return static_cast<size_t>(bits) + 1;
+    }
+    size_t candidate = static_cast<size_t>(std::llround(bits));
+    BigInteger power = powerOfTwo(candidate);
+    bool above = compareLimbs(digits_.data(), n, power.digits_.data(), power.digits_.size()) >= 0;
+    return above ? candidate + 1 : candidate;
+}
+
+// Bit index of the two's complement of x. For x < 0 that is bit index of ~(|x| - 1): the
+// borrow of |x| - 1 reaches bit index exactly when all lower bits of |x| are zero.
+bool BigInteger::test_bit(size_t index) const {
+    bool bit, lower_zero;
+#ifdef BIGINTEGER_BINARY_LIMBS
+    size_t limb = index / 64;
+    if (limb >= digits_.size()) {
+        bit = false;
+        lower_zero = false;
+    } else {
+        bit = ((digits_[limb] >> (index % 64)) & 1) != 0;
+        lower_zero = (digits_[limb] & ((Limb(1) << (index % 64)) - 1)) == 0;
+        for (size_t i = 0; i < limb && lower_zero; ++i) {
+            lower_zero = (digits_[i] == 0);
+        }
+    }
+#else
+    BigInteger magnitude = *this;
+    magnitude.is_negative_ = false;
+    if (index < 30) {
+        Limb remainder = divSmallLimbs(magnitude.digits_.data(), magnitude.digits_.size(), static_cast<Limb>(1) << index);
+        lower_zero = (remainder == 0);
+    } else {
+        BigInteger remainder;
+        divmod(magnitude, powerOfTwo(index), magnitude, remainder);
+        lower_zero = (remainder == 0);
+    }
+    bit = (magnitude.digits_[0] & 1) != 0;
+#endif
+    return is_negative_ ? (bit == lower_zero) : bit;
+}
+
+size_t BigInteger::popcount() const {
+    std::vector<Word> words;
+    toWords(words);
+    size_t count = 0;
+    for (Word word : words) {
+        count += static_cast<size_t>(__builtin_popcountll(word));
+    }
+    return count;
+}
+
+unsigned __int128 BigInteger::isqrtSmall(unsigned __int128 value) {
+    if (value == 0) {
+        return 0;
+    }
+    unsigned __int128 root = static_cast<unsigned __int128>(std::sqrt(static_cast<long double>(value)));
+    root = std::min(root, static_cast<unsigned __int128>(~0ull));
+    while (root > value / root) {
+        --root;
+    }
+    while (root + 1 <= value / (root + 1)) {
+        ++root;
+    }
+    return root;
+}
+
+// Floor of the k-th root of value > 0 by Newton's iteration from above,
+// x' = ((k - 1) x + value / x^(k - 1)) / k, which decreases until it reaches the root.
+// The start is the root of the top limbs, taken with half the precision (dropping k m
+// limbs leaves a root with m limbs less) and rounded up, so one or two full-size steps
+// finish it and the total cost is a constant number of full-size divisions.
+BigInteger BigInteger::rootNewton(const BigInteger& value, unsigned k) {
+    unsigned __int128 small;
+    if (k == 2 && toSmall(value.digits_.data(), value.digits_.size(), small)) {
+        BigInteger root;
+        root.assignSmall(isqrtSmall(small), false);
+        return root;
+    }
+    size_t n = value.digits_.size();
+    size_t m = n / (2 * k);
+    BigInteger x;
+    if (m == 0) {
+        x = powerOfTwo(static_cast<size_t>((bitLengthEstimate(value) + k) / k));
+    } else {
+        BigInteger top;
+        top.assignLimbs(value.digits_.data() + k * m, n - k * m, false);
+        x = rootNewton(top, k);
+        x += 1;
+        std::vector<Limb> shifted(m, 0);
+        shifted.insert(shifted.end(), x.digits_.begin(), x.digits_.end());
+        x.assignLimbs(shifted.data(), shifted.size(), false);
+    }
+    const BigInteger k_minus_one = static_cast<long long>(k - 1);
+    const BigInteger k_big = static_cast<long long>(k);
+    while (true) {
+        BigInteger power = 1, base = x;
+        for (unsigned e = k - 1; e > 0; e >>= 1) {
+            if (e & 1) {
+                power *= base;
+            }
+            if (e > 1) {
+                base *= base;
+            }
+        }
+        BigInteger next = value / power;
+        next += x * k_minus_one;
+        next /= k_big;
+        if (!(next < x)) {
+            return x;
+        }
+        x = std::move(next);
+    }
+}
+
+unsigned long long BigInteger::remainderSmall(const Limb* a, size_t n, unsigned long long modulus) {
+    DoubleLimb remainder = 0;
+    for (size_t i = n; i > 0; --i) {
+        remainder = (remainder * kBase_ + static_cast<DoubleLimb>(a[i - 1])) % modulus;
+    }
+    return static_cast<unsigned long long>(remainder);
+}
+
+// Bit r is set when r is a square modulo modulus (at most 64).
+constexpr unsigned long long BigInteger::squareResidues(unsigned modulus) {
+    unsigned long long mask = 0;
+    for (unsigned x = 0; x < modulus; ++x) {
+        mask |= 1ull << (x * x % modulus);
+    }
+    return mask;
+}
+
+BigInteger isqrt(const BigInteger& value) {
+    if (value.is_negative_) {
+        throw std::domain_error("isqrt of a negative number");
+    }
+    return BigInteger::rootNewton(value, 2);
+}
+
+// Rounds toward zero, so odd roots of negative numbers are the negated roots of |value|.
+BigInteger iroot(const BigInteger& value, unsigned k) {
+    if (k == 0) {
+        throw std::domain_error("iroot: zeroth root");
+    }
+    if (value.is_negative_ && k % 2 == 0) {
+        throw std::domain_error("iroot: even root of a negative number");
+    }
+    if (k == 1 || value == 0) {
+        return value;
+    }
+    BigInteger magnitude = value;
+    magnitude.is_negative_ = false;
+    BigInteger root = BigInteger::rootNewton(magnitude, k);
+    if (value.is_negative_) {
+        root.negate();
+    }
+    return root;
+}
+
+// Squares mod 64 are read off the lowest limb (2^64 and 10^9 are both multiples of 64); one
+// pass over the limbs gives the residue modulo the primes 3..23. Together they reject all
+// but about 0.2% of non-squares before a root is taken.
+bool is_perfect_square(const BigInteger& value) {
+    if (value.is_negative_) {
+        return false;
+    }
+    static constexpr unsigned long long kSquaresMod64 = BigInteger::squareResidues(64);
+    static constexpr unsigned kPrimes[] = {3, 5, 7, 11, 13, 17, 19, 23};
+    static constexpr unsigned long long kPrimeSquares[] = {
+        BigInteger::squareResidues(3), BigInteger::squareResidues(5), BigInteger::squareResidues(7),
+        BigInteger::squareResidues(11), BigInteger::squareResidues(13), BigInteger::squareResidues(17),
+        BigInteger::squareResidues(19), BigInteger::squareResidues(23)};
+    const BigInteger::LimbVector& limbs = value.digits_;
+    if (((kSquaresMod64 >> (static_cast<unsigned long long>(limbs[0]) & 63)) & 1) == 0) {
+        return false;
+    }
+    unsigned long long residue =
+        BigInteger::remainderSmall(limbs.data(), limbs.size(), BigInteger::kSquareFilterModulus_);
+    for (size_t i = 0; i < 8; ++i) {
+        if (((kPrimeSquares[i] >> (residue % kPrimes[i])) & 1) == 0) {
+            return false;
+        }
+    }
+    BigInteger root = BigInteger::rootNewton(value, 2);
+    return root * root == value;
+}
+
+std::ostream& operator<<(std::ostream& ostream, const BigInteger& number) {
+    ostream << number.toString();
+    return ostream;
+}
+
+std::istream& operator>>(std::istream& istream, BigInteger& number) {
+    std::string support;
+    istream >> support;
+    number = support;
+    return istream;
+}
+
+bool BigInteger::hostBigEndian() {
+    return __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+}
+
+// Callers reject counts above kSerialMaxCount_, which the 32-bit field cannot hold.
+void BigInteger::writeSerialHeader(char* out, unsigned char flags, size_t count) {
+    uint32_t count32 = static_cast<uint32_t>(count);
+    out[0] = static_cast<char>(kSerialVersion_);
+    out[1] = static_cast<char>(flags | (hostBigEndian() ? kSerialBigEndian_ : 0));
+    out[2] = out[3] = 0;
+    std::memcpy(out + 4, &count32, sizeof(count32));
+}
+
+bool BigInteger::readSerialHeader(const char* in, unsigned char& flags, size_t& count) {
+    uint32_t count32;
+    std::memcpy(&count32, in + 4, sizeof(count32));
+    flags = static_cast<unsigned char>(in[1]);
+    if (((flags & kSerialBigEndian_) != 0) != hostBigEndian()) {
+        count32 = __builtin_bswap32(count32);
+    }
+    count = count32;
+    return static_cast<unsigned char>(in[0]) == kSerialVersion_ && in[2] == 0 && in[3] == 0;
+}
+
+// Value of base 10^9 limbs, for reading decimal-limb data into binary limbs: the upper half
+// times 10^(9 half) plus the lower half.
+BigInteger BigInteger::fromDecimalLimbs(const unsigned* limbs, size_t n) {
+    BigInteger value;
+    if (n <= 2) {
+        unsigned __int128 small = 0;
+        for (size_t i = n; i > 0; --i) {
+            small = small * 1000000000u + limbs[i - 1];
+        }
+        value.assignSmall(small, false);
+        return value;
+    }
+    size_t half = n / 2;
+    BigInteger power = 1, base = 1000000000;
+    for (size_t e = half; e > 0; e >>= 1) {
+        if (e & 1) {
+            power *= base;
+        }
+        if (e > 1) {
+            base *= base;
+        }
+    }
+    value = fromDecimalLimbs(limbs + half, n - half);
+    value *= power;
+    value += fromDecimalLimbs(limbs, half);
+    return value;
+}
+
+size_t BigInteger::serializedSize() const {
+    return kSerialHeader_ + (digits_.size() * sizeof(Limb) + 7) / 8 * 8;
+}
+
+std::to_chars_result BigInteger::serialize(char* first, char* last) const {
+    size_t size = serializedSize();
+    if (static_cast<size_t>(last - first) < size || digits_.size() > kSerialMaxCount_) {
+        return {last, std::errc::value_too_large};
+    }
+    unsigned char flags = (is_negative_ ? kSerialNegative_ : 0) | (kBinaryLimbs_ ? kSerialBinaryLimbs_ : 0);
+    writeSerialHeader(first, flags, digits_.size());
+    size_t bytes = digits_.size() * sizeof(Limb);
+    std::memcpy(first + kSerialHeader_, digits_.data(), bytes);
+    std::memset(first + kSerialHeader_ + bytes, 0, size - kSerialHeader_ - bytes);
+    return {first + size, std::errc()};
+}
+
+// Read-only view of one serialized BigInteger inside a caller's buffer (for instance an
+// mmapped file): parsing checks the header, bounds and limb ranges but copies nothing. Limbs
+// written by a build with the same limb kind and byte order are native() and can be read in
+// place; value() converts anything else.
+class BigIntegerView {
+private:
+    const char* limbs_ = nullptr;
+    size_t count_ = 0;
+    unsigned char flags_ = 0;
+
+public:
+    std::from_chars_result deserialize(const char* first, const char* last);
+
+    bool is_negative() const { return (flags_ & BigInteger::kSerialNegative_) != 0; }
+    size_t size() const { return count_; }
+    bool native() const;
+    const BigInteger::Limb* limbs() const { return reinterpret_cast<const BigInteger::Limb*>(limbs_); }
+    BigInteger value() const;
+};
+
+std::from_chars_result BigIntegerView::deserialize(const char* first, const char* last) {
+    if (static_cast<size_t>(last - first) < BigInteger::kSerialHeader_) {
+        return {first, std::errc::invalid_argument};
+    }
+    unsigned char flags;
+    size_t count;
+    if (!BigInteger::readSerialHeader(first, flags, count) || (flags & BigInteger::kSerialBatch_) != 0) {
+        return {first, std::errc::not_supported};
+    }
+    size_t limb_size = (flags & BigInteger::kSerialBinaryLimbs_) != 0 ? 8 : 4;
+    size_t size = BigInteger::kSerialHeader_ + (count * limb_size + 7) / 8 * 8;
+    if (count == 0 || static_cast<size_t>(last - first) < size) {
+        return {first, std::errc::invalid_argument};
+    }
+    // Decimal limbs must lie below 10^9, so that value() cannot fail on a parsed view.
+    if (limb_size == 4) {
+        bool swap_bytes = ((flags & BigInteger::kSerialBigEndian_) != 0) != BigInteger::hostBigEndian();
+        for (size_t i = 0; i < count; ++i) {
+            unsigned limb;
+            std::memcpy(&limb, first + BigInteger::kSerialHeader_ + i * 4, sizeof(limb));
+            if ((swap_bytes ? __builtin_bswap32(limb) : limb) >= 1000000000u) {
+                return {first, std::errc::invalid_argument};
+            }
+        }
+    }
+    limbs_ = first + BigInteger::kSerialHeader_;
+    count_ = count;
+    flags_ = flags;
+    return {first + size, std::errc()};
+}
+
+bool BigIntegerView::native() const {
+    return ((flags_ & BigInteger::kSerialBinaryLimbs_) != 0) == BigInteger::kBinaryLimbs_ &&
+           ((flags_ & BigInteger::kSerialBigEndian_) != 0) == BigInteger::hostBigEndian();
+}
+
+BigInteger BigIntegerView::value() const {
+    bool swap_bytes = ((flags_ & BigInteger::kSerialBigEndian_) != 0) != BigInteger::hostBigEndian();
+    BigInteger value;
+    if ((flags_ & BigInteger::kSerialBinaryLimbs_) != 0) {
+        std::vector<BigInteger::Word> words(count_);
+        std::memcpy(words.data(), limbs_, count_ * sizeof(BigInteger::Word));
+        if (swap_bytes) {
+            for (BigInteger::Word& word : words) {
+                word = __builtin_bswap64(word);
+            }
+        }
+        value.assignWords(words.data(), count_, is_negative());
+        return value;
+    }
+    std::vector<unsigned> limbs(count_);
+    std::memcpy(limbs.data(), limbs_, count_ * sizeof(unsigned));
+    if (swap_bytes) {
+        for (unsigned& limb : limbs) {
+            limb = __builtin_bswap32(limb);
+        }
+    }
+    if (BigInteger::kBinaryLimbs_) {
+        value = BigInteger::fromDecimalLimbs(limbs.data(), count_);
+        if (is_negative()) {
+            value.negate();
+        }
+    } else {
+        std::vector<BigInteger::Limb> native(limbs.begin(), limbs.end());
+        value.assignLimbs(native.data(), BigInteger::trimLimbs(native.data(), count_), is_negative());
+    }
+    return value;
+}
+
+std::from_chars_result BigInteger::deserialize(const char* first, const char* last) {
+    BigIntegerView view;
+    std::from_chars_result result = view.deserialize(first, last);
+    if (result.ec == std::errc()) {
+        *this = view.value();
+    }
+    return result;
+}
+
+// Lazy arithmetic, opt-in through lazy(): `x = (lazy(a) * b + c) % m` records the expression
+// tree and evaluates it straight into x. Compound operands are computed in the destination's
+// limbs, so a multiply-add is one product plus an in-place add and a multiply-mod reduces the
+// product where it lies. Operands are held by reference: assign the expression in the same
+// statement that builds it.
+template <typename Derived>
+class BigIntegerExpression {
+public:
+    const Derived& derived() const { return static_cast<const Derived&>(*this); }
+};
+
+class BigIntegerTerminal : public BigIntegerExpression<BigIntegerTerminal> {
+public:
+    static const bool kTerminal = true;
+
+    explicit BigIntegerTerminal(const BigInteger& value) : value_(&value) {}
+
+    void evaluate(BigInteger& result) const {
+        if (&result != value_) {
+            result = *value_;
+        }
+    }
+    const BigInteger& value(BigInteger&) const { return *value_; }
+    bool refersTo(const BigInteger* target) const { return value_ == target; }
+
+private:
+    const BigInteger* value_;
+};
+
+// Integer operands are stored by value, the inline limbs hold them without allocating.
+class BigIntegerConstant : public BigIntegerExpression<BigIntegerConstant> {
+public:
+    static const bool kTerminal = true;
+
+    explicit BigIntegerConstant(long long value) : value_(value) {}
+
+    void evaluate(BigInteger& result) const { result = value_; }
+    const BigInteger& value(BigInteger&) const { return value_; }
+    bool refersTo(const BigInteger*) const { return false; }
+
+private:
+    BigInteger value_;
+};
+
+template <char Op, typename Left, typename Right>
+class BigIntegerBinaryExpression
+        : public BigIntegerExpression<BigIntegerBinaryExpression<Op, Left, Right>> {
+public:
+    static const bool kTerminal = false;
+
+    BigIntegerBinaryExpression(const Left& left, const Right& right) : left_(left), right_(right) {}
+
+    // result must not be referenced by the expression.
+    void evaluate(BigInteger& result) const;
+    const BigInteger& value(BigInteger& buffer) const {
+        evaluate(buffer);
+        return buffer;
+    }
+    bool refersTo(const BigInteger* target) const {
+        return left_.refersTo(target) || right_.refersTo(target);
+    }
+
+private:
+    Left left_;
+    Right right_;
+};
+
+// The compound side of a commutative operation is evaluated into result, the other side is
+// then applied in place; a terminal dividend is divided without being copied first.
+template <char Op, typename Left, typename Right>
+void BigIntegerBinaryExpression<Op, Left, Right>::evaluate(BigInteger& result) const {
+    BigInteger buffer;
+    if constexpr (Op == '*') {
+        if constexpr (Left::kTerminal && Right::kTerminal) {
+            result.assignProduct(left_.value(buffer), right_.value(buffer));
+        } else if constexpr (Left::kTerminal) {
+            right_.evaluate(result);
+            result.assignProduct(result, left_.value(buffer));
+        } else {
+            left_.evaluate(result);
+            result.assignProduct(result, right_.value(buffer));
+        }
+    } else if constexpr ((Op == '/' || Op == '%') && Left::kTerminal) {
+        BigInteger other;
+        const BigInteger& divisor = right_.value(buffer);
+        if constexpr (Op == '/') {
+            divmod(left_.value(buffer), divisor, result, other);
+        } else {
+            divmod(left_.value(buffer), divisor, other, result);
+        }
+    } else if constexpr (Op != '/' && Op != '%' && Left::kTerminal && !Right::kTerminal) {
+        right_.evaluate(result);
+        if constexpr (Op == '+') {
+            result += left_.value(buffer);
+        } else {
+            result -= left_.value(buffer);
+            result.negate();
+        }
+    } else {
+        if constexpr (Left::kTerminal) {
+            result.reserve(std::max(left_.value(buffer).data().size(),
+                                    right_.value(buffer).data().size()) + 1);
+        }
+        left_.evaluate(result);
+        const BigInteger& other = right_.value(buffer);
+        if constexpr (Op == '+') {
+            result += other;
+        } else if constexpr (Op == '-') {
+            result -= other;
+        } else if constexpr (Op == '/') {
+            result /= other;
+        } else {
+            result %= other;
+        }
+    }
+}
+
+template <typename Expression>
+BigInteger::BigInteger(const BigIntegerExpression<Expression>& expression) : digits_(1, 0) {
+    expression.derived().evaluate(*this);
+}
+
+template <typename Expression>
+BigInteger& BigInteger::operator=(const BigIntegerExpression<Expression>& expression) {
+    if (expression.derived().refersTo(this)) {
+        BigInteger result;
+        expression.derived().evaluate(result);
+        swap(*this, result);
+    } else {
+        expression.derived().evaluate(*this);
+    }
+    return *this;
+}
+
+inline BigIntegerTerminal lazy(const BigInteger& value) {
+    return BigIntegerTerminal(value);
+}
+
+#define BIGINTEGER_EXPRESSION_OPERATOR(op)                                                         \
+    template <typename Left, typename Right>                                                       \
+    BigIntegerBinaryExpression<#op[0], Left, Right> operator op(                                   \
+            const BigIntegerExpression<Left>& left, const BigIntegerExpression<Right>& right) {    \
+        return {left.derived(), right.derived()};                                                  \
+    }                                                                                              \
+    template <typename Left>                                                                       \
+    BigIntegerBinaryExpression<#op[0], Left, BigIntegerTerminal> operator op(                      \
+            const BigIntegerExpression<Left>& left, const BigInteger& right) {                     \
+        return {left.derived(), BigIntegerTerminal(right)};                                        \
+    }                                                                                              \
+    template <typename Right>                                                                      \
+    BigIntegerBinaryExpression<#op[0], BigIntegerTerminal, Right> operator op(                     \
+            const BigInteger& left, const BigIntegerExpression<Right>& right) {                    \
+        return {BigIntegerTerminal(left), right.derived()};                                        \
+    }                                                                                              \
+    template <typename Left>                                                                       \
+    BigIntegerBinaryExpression<#op[0], Left, BigIntegerConstant> operator op(                      \
+            const BigIntegerExpression<Left>& left, long long right) {                             \
+        return {left.derived(), BigIntegerConstant(right)};                                        \
+    }                                                                                              \
+    template <typename Right>                                                                      \
+    BigIntegerBinaryExpression<#op[0], BigIntegerConstant, Right> operator op(                     \
+            long long left, const BigIntegerExpression<Right>& right) {                            \
+        return {BigIntegerConstant(left), right.derived()};                                        \
+    }
+
+BIGINTEGER_EXPRESSION_OPERATOR(+)
+BIGINTEGER_EXPRESSION_OPERATOR(-)
+BIGINTEGER_EXPRESSION_OPERATOR(*)
+BIGINTEGER_EXPRESSION_OPERATOR(/)
+BIGINTEGER_EXPRESSION_OPERATOR(%)
+
+#undef BIGINTEGER_EXPRESSION_OPERATOR
+
+// Arithmetic modulo a fixed m > 0 with the per-modulus setup done once. Residues are kept as
+// n-limb vectors. Montgomery reduction is used when m is coprime to the limb base (m odd in
+// binary mode; odd and not a multiple of 5 with 10^9 limbs), Barrett reduction otherwise.
+class BigIntegerModulus {
+private:
+    using Limb = BigInteger::Limb;
+    using DoubleLimb = BigInteger::DoubleLimb;
+
+    BigInteger modulus_;
+    std::vector<Limb> m_;
+    size_t n_;
+    bool montgomery_;
+    Limb inverse_;             // -m^-1 mod kBase_ (Montgomery)
+    std::vector<Limb> r2_;     // kBase_^2n mod m (Montgomery)
+    std::vector<Limb> one_;    // 1 in the working representation
+    std::vector<Limb> mu_;     // floor(kBase_^2n / m), n + 2 limbs (Barrett)
+
+    std::vector<Limb> residue(const BigInteger& value) const;
+    void multiply(const Limb* a, const Limb* b, Limb* out, Limb* scratch) const;
+    void montgomeryReduce(Limb* t) const;
+    void barrettReduce(const Limb* x, Limb* out, Limb* scratch) const;
+    static std::vector<unsigned char> exponentBits(const BigInteger& exponent);
+
+public:
+    explicit BigIntegerModulus(const BigInteger& modulus);
+
+    const BigInteger& modulus() const { return modulus_; }
+    BigInteger reduce(const BigInteger& value) const;
+    BigInteger multiply(const BigInteger& a, const BigInteger& b) const;
+    BigInteger pow(const BigInteger& base, const BigInteger& exponent) const;
+};
+
+BigInteger powmod(const BigInteger& base, const BigInteger& exponent, const BigInteger& modulus);
+
+BigIntegerModulus::BigIntegerModulus(const BigInteger& modulus) : modulus_(modulus) {
+    size_t n = BigInteger::trimLimbs(modulus.digits_.data(), modulus.digits_.size());
+    if (n == 0 || modulus.is_negative()) {
+        throw std::domain_error("BigIntegerModulus: modulus must be positive");
+    }
+    n_ = n;
+    m_.assign(modulus.digits_.begin(), modulus.digits_.begin() + n);
+    Limb m0 = m_[0];
+    montgomery_ = BigInteger::kBinaryLimbs_ ? (m0 % 2 != 0) : (m0 % 2 != 0 && m0 % 5 != 0);
+    const DoubleLimb base = BigInteger::kBase_;
+    std::vector<Limb> power(2 * n_ + 1, 0), quotient, remainder;
+    power[2 * n_] = 1;
+    if (montgomery_) {
+        // Newton iteration doubles the number of correct low digits of m0^-1 each step.
+        DoubleLimb x = m0;
+        if (!BigInteger::kBinaryLimbs_) {
+            x = 1;
+            while ((m0 * x) % 10 != 1) {
+                ++x;
             }
-            support -= (other.is_negative_) ? left*(-other) : left * other;
-            result.digits_.push_back(left);
-        } else {
-            result.digits_.push_back(0);
+        }
+        for (int i = 0; i < 6; ++i) {
+            DoubleLimb t = (m0 * x) % base;
+            x = x * ((2 + base - t) % base) % base;
+        }
+        inverse_ = static_cast<Limb>((base - x) % base);
+        BigInteger::divmodLimbs(power.data(), power.size(), m_.data(), n_, quotient, r2_);
+        r2_.resize(n_, 0);
+        power.assign(n_ + 1, 0);
+        power[n_] = 1;
+        BigInteger::divmodLimbs(power.data(), power.size(), m_.data(), n_, quotient, one_);
+        one_.resize(n_, 0);
+    } else {
+        inverse_ = 0;
+        BigInteger::divmodLimbs(power.data(), power.size(), m_.data(), n_, mu_, remainder);
+        mu_.resize(n_ + 2, 0);
+        one_.assign(n_, 0);
+        one_[0] = (n_ > 1 || m0 > 1) ? 1 : 0;
+    }
+}
+
+// t[0..2n + 1) holds a value below m * kBase_^n; leaves t * kBase_^-n mod m in t[n..2n).
+void BigIntegerModulus::montgomeryReduce(Limb* t) const {
+    const DoubleLimb base = BigInteger::kBase_;
+    for (size_t i = 0; i < n_; ++i) {
+        Limb u = static_cast<Limb>((static_cast<DoubleLimb>(t[i]) * inverse_) % base);
+        DoubleLimb carry = 0;
+        for (size_t j = 0; j < n_; ++j) {
+            DoubleLimb cur = t[i + j] + static_cast<DoubleLimb>(u) * m_[j] + carry;
+            t[i + j] = static_cast<Limb>(cur % base);
+            carry = cur / base;
+        }
+        for (size_t k = i + n_; carry != 0; ++k) {
+            DoubleLimb cur = t[k] + carry;
+            t[k] = static_cast<Limb>(cur % base);
+            carry = cur / base;
         }
     }
-    for (int i = 0; i < static_cast<int>(result.data().size()) / 2; ++i) {
-        std::swap(result.digits_[static_cast<int>(result.data().size()) - i - 1], result.digits_[i]);
+    if (t[2 * n_] != 0 || BigInteger::compareLimbs(t + n_, n_, m_.data(), n_) >= 0) {
+        BigInteger::subLimbs(t + n_, n_ + 1, m_.data(), n_);
     }
-    *this = result;
-    popZeros();
-    is_negative_ = res_is_negative;
-    return *this;
 }
 
-BigInteger& BigInteger::operator%=(const BigInteger& other) {
-    *this = *this - (*this / other) * other;
-    return *this;
+// x[0..2n) < kBase_^2n; out[0..n) = x mod m with at most two correction subtractions.
+void BigIntegerModulus::barrettReduce(const Limb* x, Limb* out, Limb* scratch) const {
+    Limb* q2 = scratch;
+    Limb* r2 = scratch + 2 * n_ + 3;
+    BigInteger::mulLimbs(x + n_ - 1, n_ + 1, mu_.data(), n_ + 2, q2);
+    BigInteger::mulLimbs(q2 + n_ + 1, n_ + 2, m_.data(), n_, r2);
+    Limb* r = q2;
+    std::copy(x, x + n_ + 1, r);
+    BigInteger::subLimbs(r, n_ + 1, r2, n_ + 1);
+    while (BigInteger::compareLimbs(r, n_ + 1, m_.data(), n_) >= 0) {
+        BigInteger::subLimbs(r, n_ + 1, m_.data(), n_);
+    }
+    std::copy(r, r + n_, out);
 }
 
-std::ostream& operator<<(std::ostream& ostream, const BigInteger& number) {
-    ostream << number.toString();
-    return ostream;
+// out = a * b in the working representation; scratch holds 6n + 6 limbs.
+void BigIntegerModulus::multiply(const Limb* a, const Limb* b, Limb* out, Limb* scratch) const {
+    Limb* t = scratch;
+    BigInteger::mulLimbs(a, n_, b, n_, t);
+    if (montgomery_) {
+        t[2 * n_] = 0;
+        montgomeryReduce(t);
+        std::copy(t + n_, t + 2 * n_, out);
+    } else {
+        barrettReduce(t, out, scratch + 2 * n_ + 1);
+    }
 }
 
-std::istream& operator>>(std::istream& istream, BigInteger& number) {
-    std::string support;
-    istream >> support;
-    number = support;
-    return istream;
+std::vector<BigIntegerModulus::Limb> BigIntegerModulus::residue(const BigInteger& value) const {
+    BigInteger reduced = reduce(value);
+    std::vector<Limb> limbs(reduced.digits_.begin(), reduced.digits_.end());
+    limbs.resize(n_, 0);
+    return limbs;
+}
+
+BigInteger BigIntegerModulus::reduce(const BigInteger& value) const {
+    BigInteger quotient, remainder;
+    divmod(value, modulus_, quotient, remainder);
+    if (remainder.is_negative()) {
+        remainder += modulus_;
+    }
+    return remainder;
+}
+
+BigInteger BigIntegerModulus::multiply(const BigInteger& a, const BigInteger& b) const {
+    std::vector<Limb> x = residue(a), y = residue(b), scratch(6 * n_ + 6);
+    multiply(x.data(), y.data(), x.data(), scratch.data());
+    if (montgomery_) {
+        multiply(x.data(), r2_.data(), x.data(), scratch.data());
+    }
+    BigInteger result;
+    result.assignLimbs(x.data(), n_, false);
+    return result;
+}
+
+// Exponent bits, least significant first.
+std::vector<unsigned char> BigIntegerModulus::exponentBits(const BigInteger& exponent) {
+    size_t n = BigInteger::trimLimbs(exponent.digits_.data(), exponent.digits_.size());
+    std::vector<unsigned char> bits;
+    if (BigInteger::kBinaryLimbs_) {
+        for (size_t i = 0; i < n; ++i) {
+            for (int j = 0; j < 64; ++j) {
+                bits.push_back(static_cast<unsigned char>((exponent.digits_[i] >> j) & 1));
+            }
+        }
+    } else {
+        std::vector<Limb> value(exponent.digits_.begin(), exponent.digits_.begin() + n);
+        while (n > 0) {
+            Limb chunk = BigInteger::divSmallLimbs(value.data(), n, 1 << 16);
+            for (int j = 0; j < 16; ++j) {
+                bits.push_back(static_cast<unsigned char>((chunk >> j) & 1));
+            }
+            n = BigInteger::trimLimbs(value.data(), n);
+        }
+    }
+    while (!bits.empty() && bits.back() == 0) {
+        bits.pop_back();
+    }
+    return bits;
+}
+
+// Left-to-right sliding window over the odd powers base^1, base^3, ..., base^(2^k - 1).
+BigInteger BigIntegerModulus::pow(const BigInteger& base, const BigInteger& exponent) const {
+    if (exponent.is_negative() && exponent != 0) {
+        throw std::domain_error("BigIntegerModulus: negative exponent");
+    }
+    std::vector<unsigned char> bits = exponentBits(exponent);
+    size_t len = bits.size();
+    size_t k = len <= 8 ? 1 : len <= 24 ? 2 : len <= 80 ? 3 : len <= 240 ? 4 : len <= 672 ? 5 : 6;
+    std::vector<Limb> scratch(6 * n_ + 6), acc = one_;
+    std::vector<std::vector<Limb>> table(size_t(1) << (k - 1), std::vector<Limb>(n_));
+    table[0] = residue(base);
+    if (montgomery_) {
+        multiply(table[0].data(), r2_.data(), table[0].data(), scratch.data());
+    }
+    if (table.size() > 1) {
+        std::vector<Limb> square(n_);
+        multiply(table[0].data(), table[0].data(), square.data(), scratch.data());
+        for (size_t i = 1; i < table.size(); ++i) {
+            multiply(table[i - 1].data(), square.data(), table[i].data(), scratch.data());
+        }
+    }
+    bool started = false;
+    for (size_t i = len; i > 0;) {
+        if (bits[i - 1] == 0) {
+            multiply(acc.data(), acc.data(), acc.data(), scratch.data());
+            --i;
+            continue;
+        }
+        size_t low = (i > k) ? i - k : 0;
+        while (bits[low] == 0) {
+            ++low;
+        }
+        size_t window = 0;
+        for (size_t j = i; j > low; --j) {
+            window = 2 * window + bits[j - 1];
+            if (started) {
+                multiply(acc.data(), acc.data(), acc.data(), scratch.data());
+            }
+        }
+        if (started) {
+            multiply(acc.data(), table[window / 2].data(), acc.data(), scratch.data());
+        } else {
+            acc = table[window / 2];
+            started = true;
+        }
+        i = low;
+    }
+    if (montgomery_) {
+        std::vector<Limb> unit(n_, 0);
+        unit[0] = 1;
+        multiply(acc.data(), unit.data(), acc.data(), scratch.data());
+    }
+    BigInteger result;
+    result.assignLimbs(acc.data(), n_, false);
+    return result;
+}
+
+BigInteger powmod(const BigInteger& base, const BigInteger& exponent, const BigInteger& modulus) {
+    return BigIntegerModulus(modulus).pow(base, exponent);
 }
 
 class Rational{
@@ -423,6 +3384,54 @@ private:
     BigInteger numer_ = 0;
     BigInteger denom_ = 1;
     bool is_negative_ = false;
+    // While numerator and denominator fit in long long they live in small_numer_ and
+    // small_denom_ (magnitudes, always reduced) and numer_/denom_ are not kept up to date.
+    bool is_small_ = true;
+    long long small_numer_ = 0;
+    long long small_denom_ = 1;
+    // Lazy reduction: with lazy_limbs_ != 0 the big representation is only reduced once it
+    // grew by lazy_limbs_ limbs since the last reduction, or for output and ==.
+    size_t lazy_limbs_ = 0;
+    size_t reduced_limbs_ = 2;
+    bool is_reduced_ = true;
+
+    void promote();
+    void demote();
+    void normalize();
+    void invert();
+    void add(const Rational& other, bool subtract);
+    void setReduced(BigInteger& numer, BigInteger& denom, bool negative);
+    bool smallAdd(const Rational& other, bool subtract);
+    bool smallMultiply(long long numer, long long denom, bool negative);
+    template <typename Float>
+    Float toFloating() const;
+    static double logMagnitude(const BigInteger& value);
+    static int compareMagnitudes(const Rational& a, const Rational& b);
+
+    static const size_t kDecimalBlockChunks_ = 64;
+    static const unsigned long long kDecimalWordLimit_ = 1ull << 59;
+
+public:
+    // Fractional digits [start, start + length) repeat forever; a terminating expansion has
+    // length 0 and start just past its last nonzero digit. found is false when neither
+    // showed up within the digits that were generated.
+    struct DecimalPeriod {
+        bool found = false;
+        size_t start = 0;
+        size_t length = 0;
+    };
+
+private:
+    static void decimalBlock(BigInteger& remainder, const BigInteger& denom, const BigInteger& scale,
+                             size_t chunks, std::string& digits);
+    static DecimalPeriod decimalPeriod(const BigInteger& first, const BigInteger& cycle,
+                                       size_t cycle_start, size_t cycle_digits, const BigInteger& denom);
+    template <typename Sink>
+    static DecimalPeriod writeDecimalWord(unsigned long long remainder, unsigned long long denom,
+                                          size_t precision, Sink& sink);
+    template <typename Sink>
+    static DecimalPeriod writeDecimalBlocks(BigInteger& remainder, const BigInteger& denom,
+                                            size_t precision, Sink& sink);
 
 public:
     Rational();
@@ -436,13 +3445,26 @@ public:
     Rational operator-() const;
 
     bool is_negative() const;
+    size_t hash() const;
+    BigInteger numerator() const;
+    BigInteger denominator() const;
     void makeUnsigned();
     void toReduce();
+    void setLazyReduction(size_t limbs);
     std::string toString() const;
     std::string asDecimal(size_t precision = 0) const;
+    size_t serializedSize() const;
+    std::to_chars_result serialize(char* first, char* last) const;
+    std::from_chars_result deserialize(const char* first, const char* last);
+    template <typename Sink, typename = std::enable_if_t<
+                                 !std::is_base_of<std::ostream, std::decay_t<Sink>>::value>>
+    DecimalPeriod writeDecimal(size_t precision, Sink&& sink) const;
+    DecimalPeriod writeDecimal(size_t precision, std::ostream& ostream) const;
     friend bool operator<(const Rational& a, const Rational& b);
+    friend bool operator==(const Rational& a, const Rational& b);
 
     explicit operator double() const;
+    explicit operator long double() const;
 };
 
 bool operator<=(const Rational& a, const Rational& b);
@@ -456,7 +3478,10 @@ Rational operator-(const Rational& left, const Rational& other);
 Rational operator*(const Rational& left, const Rational& other);
 Rational operator/(const Rational& left, const Rational& other);
 
-BigInteger GCD(BigInteger first, BigInteger second);
+template <>
+struct std::hash<Rational> {
+    size_t operator()(const Rational& value) const { return value.hash(); }
+};
 
 Rational::Rational() {}
 
@@ -464,12 +3489,21 @@ Rational::Rational(const BigInteger& other) {
     is_negative_ = other.is_negative();
     numer_ = (other < 0) ? -other : other;
     denom_ = 1;
+    is_small_ = false;
+    demote();
 }
 
 Rational::Rational(long long value) {
     is_negative_ = bool(value < 0);
-    numer_ = (value < 0) ? BigInteger(-value) : BigInteger(value);
-    denom_ = 1;
+    if (__builtin_sub_overflow(0, value, &small_numer_) || value >= 0) {
+        small_numer_ = value;
+    }
+    if (small_numer_ < 0) {
+        numer_ = BigInteger(value);
+        numer_.makeUnsigned();
+        denom_ = 1;
+        is_small_ = false;
+    }
 }
 
 Rational Rational::operator-() const {
@@ -484,90 +3518,553 @@ bool Rational::is_negative() const {
     return is_negative_;
 }
 
+// Hashes the reduced magnitudes as BigIntegers, so a value hashes the same in the small and
+// the big representation and with a lazy reduction pending.
+size_t Rational::hash() const {
+    if (!is_small_ && !is_reduced_) {
+        Rational copy = *this;
+        copy.toReduce();
+        return copy.hash();
+    }
+    BigInteger small_numer, small_denom;
+    if (is_small_) {
+        small_numer = small_numer_;
+        small_denom = small_denom_;
+    }
+    const BigInteger& numer = is_small_ ? small_numer : numer_;
+    const BigInteger& denom = is_small_ ? small_denom : denom_;
+    size_t n = BigInteger::trimLimbs(denom.digits_.data(), denom.digits_.size());
+    return ByteHash::hash(denom.digits_.data(), n * sizeof(BigInteger::Limb),
+                          numer.hash() + (is_negative_ ? 1 : 0));
+}
+
+BigInteger Rational::numerator() const {
+    BigInteger numer = is_small_ ? BigInteger(small_numer_) : numer_;
+    if (is_negative_) {
+        numer.negate();
+    }
+    return numer;
+}
+
+BigInteger Rational::denominator() const {
+    return is_small_ ? BigInteger(small_denom_) : denom_;
+}
+
 void Rational::makeUnsigned() {
     is_negative_ = false;
 }
 
-BigInteger GCD(BigInteger first, BigInteger second) {
-    if (second == 1) {
-        return 1;
+void Rational::promote() {
+    if (is_small_) {
+        numer_ = small_numer_;
+        denom_ = small_denom_;
+        is_small_ = false;
+        reduced_limbs_ = numer_.data().size() + denom_.data().size();
     }
-    if (first.is_negative()) {
-        first = -first;
+}
+
+void Rational::demote() {
+    unsigned __int128 numer, denom;
+    if (is_small_ || !is_reduced_ ||
+        !BigInteger::toSmall(numer_.digits_.data(), numer_.digits_.size(), numer) ||
+        !BigInteger::toSmall(denom_.digits_.data(), denom_.digits_.size(), denom)) {
+        return;
     }
-    if (second.is_negative()) {
-        second = -second;
+    const unsigned __int128 limit = static_cast<unsigned long long>(-1) >> 1;
+    if (numer <= limit && denom <= limit) {
+        small_numer_ = static_cast<long long>(numer);
+        small_denom_ = static_cast<long long>(denom);
+        is_small_ = true;
+    }
+}
+
+// Reduces after a big-representation operation unless lazy reduction may still wait.
+void Rational::normalize() {
+    if (lazy_limbs_ == 0 ||
+        numer_.data().size() + denom_.data().size() >= reduced_limbs_ + lazy_limbs_) {
+        toReduce();
+    } else {
+        is_reduced_ = false;
+    }
+}
+
+void Rational::invert() {
+    if (*this == 0) {
+        throw std::domain_error("Rational division by zero");
+    }
+    std::swap(small_numer_, small_denom_);
+    swap(numer_, denom_);
+}
+
+void Rational::setLazyReduction(size_t limbs) {
+    lazy_limbs_ = limbs;
+    if (limbs == 0) {
+        toReduce();
+    }
+}
+
+// *this +/- other in the big representation.
+void Rational::add(const Rational& other, bool subtract) {
+    promote();
+    Rational promoted;
+    const Rational* source = &other;
+    if (other.is_small_) {
+        promoted = other;
+        promoted.promote();
+        source = &promoted;
     }
-    if (first == 0) {
-        return second;
+    bool other_negative = (source->is_negative_ != subtract);
+    if (lazy_limbs_ != 0 || !is_reduced_ || !source->is_reduced_) {
+        BigInteger left = numer_ * source->denom_;
+        BigInteger right = source->numer_ * denom_;
+        if (is_negative_) {
+            left = -std::move(left);
+        }
+        if (other_negative) {
+            right = -std::move(right);
+        }
+        left += right;
+        is_negative_ = left.is_negative();
+        left.makeUnsigned();
+        swap(numer_, left);
+        denom_ *= source->denom_;
+        normalize();
+        return;
+    }
+    // Henrici: with g = gcd(b, d), a/b + c/d = (a (d/g) + c (b/g)) / ((b/g) d), and only
+    // gcd(numerator, g) can still divide the result.
+    BigInteger g = GCD(denom_, source->denom_);
+    BigInteger left, right, denom;
+    if (g == 1) {
+        left = numer_ * source->denom_;
+        right = source->numer_ * denom_;
+        denom = denom_ * source->denom_;
+    } else {
+        BigInteger reduced_denom = denom_ / g;
+        left = numer_ * (source->denom_ / g);
+        right = source->numer_ * reduced_denom;
+        if (is_negative_) {
+            left = -std::move(left);
+        }
+        if (other_negative) {
+            right = -std::move(right);
+        }
+        left += right;
+        BigInteger common = GCD(left, g);
+        if (common != 1) {
+            left /= common;
+        }
+        denom = reduced_denom * ((common != 1) ? source->denom_ / common : source->denom_);
+        setReduced(left, denom, left.is_negative());
+        return;
+    }
+    if (is_negative_) {
+        left = -std::move(left);
+    }
+    if (other_negative) {
+        right = -std::move(right);
+    }
+    left += right;
+    setReduced(left, denom, left.is_negative());
+}
+
+// Takes numer / denom, known to be in lowest terms, as the new value.
+void Rational::setReduced(BigInteger& numer, BigInteger& denom, bool negative) {
+    numer.makeUnsigned();
+    swap(numer_, numer);
+    swap(denom_, denom);
+    is_negative_ = negative && numer_ != 0;
+    if (numer_ == 0) {
+        denom_ = 1;
+    }
+    is_reduced_ = true;
+    reduced_limbs_ = numer_.data().size() + denom_.data().size();
+    demote();
+}
+
+// this +/- other with both small; false, leaving *this untouched, when a step overflows.
+bool Rational::smallAdd(const Rational& other, bool subtract) {
+    long long a = is_negative_ ? -small_numer_ : small_numer_;
+    long long b = (other.is_negative_ != subtract) ? -other.small_numer_ : other.small_numer_;
+    long long g = std::gcd(small_denom_, other.small_denom_);
+    long long left, right, numer, denom;
+    if (__builtin_mul_overflow(a, other.small_denom_ / g, &left) ||
+        __builtin_mul_overflow(b, small_denom_ / g, &right) ||
+        __builtin_add_overflow(left, right, &numer)) {
+        return false;
+    }
+    bool negative = numer < 0;
+    if (negative && __builtin_sub_overflow(0, numer, &numer)) {
+        return false;
+    }
+    long long common = std::gcd(numer, g);
+    if (__builtin_mul_overflow(small_denom_ / g, other.small_denom_ / common, &denom)) {
+        return false;
     }
-    if (second == 0) {
-        return first;
+    small_numer_ = numer / common;
+    small_denom_ = (small_numer_ == 0) ? 1 : denom;
+    is_negative_ = negative;
+    return true;
+}
+
+// this *= sign * numer / denom with both small; false, leaving *this untouched, on overflow.
+bool Rational::smallMultiply(long long numer, long long denom, bool negative) {
+    long long g1 = std::gcd(small_numer_, denom), g2 = std::gcd(numer, small_denom_);
+    long long n, d;
+    if (__builtin_mul_overflow(small_numer_ / g1, numer / g2, &n) ||
+        __builtin_mul_overflow(small_denom_ / g2, denom / g1, &d)) {
+        return false;
     }
-    if (first <= second) {
-        return GCD(first, (second % first));
+    small_numer_ = n;
+    small_denom_ = d;
+    is_negative_ = (n != 0) && (is_negative_ != negative);
+    if (n == 0) {
+        small_denom_ = 1;
     }
-    return GCD((first % second), second);
+    return true;
 }
 
+
 void Rational::toReduce() {
-    BigInteger a = GCD(BigInteger(numer_), BigInteger(denom_));
-    numer_ /= a;
-    denom_ /= a;
+    if (is_small_) {
+        return;
+    }
+    is_reduced_ = true;
+    BigInteger a = GCD(numer_, denom_);
+    if (a != 1) {
+        BigInteger remainder;
+        divmod(numer_, a, numer_, remainder);
+        divmod(denom_, a, denom_, remainder);
+    }
+    reduced_limbs_ = numer_.data().size() + denom_.data().size();
+    demote();
 }
 
 std::string Rational::toString() const {
+    if (!is_reduced_) {
+        Rational copy = *this;
+        copy.toReduce();
+        return copy.toString();
+    }
     std::string s;
     if (is_negative_) {
         s += "-";
     }
+    if (is_small_) {
+        s += std::to_string(small_numer_);
+        return (small_denom_ == 1) ? s : s + '/' + std::to_string(small_denom_);
+    }
     if (denom_ == 1) return s + numer_.toString();
     return s + numer_.toString() + '/' + denom_.toString();
 }
 
-std::string Rational::asDecimal(size_t precision) const {
-    std::string support = numer_.toString();
-    std::string support2(precision, '0');
-    support += support2;
-    BigInteger other(support);
-    other /= denom_;
-    if (other == 0) {
-        std::string result = "0.";
-        std::string sup(precision, '0');
-        result += sup;
-        return result;
+// Writes the next chunks * 9 fractional digits of remainder / denom into digits and leaves
+// the new remainder; scale is 10^(9 chunks) for binary limbs and unused otherwise.
+void Rational::decimalBlock(BigInteger& remainder, const BigInteger& denom, const BigInteger& scale,
+                            size_t chunks, std::string& digits) {
+    const size_t width = 9 * chunks;
+    BigInteger quotient;
+    if (BigInteger::kBinaryLimbs_) {
+        remainder *= scale;
+        divmod(remainder, denom, quotient, remainder);
+        digits.assign(width + 1, '0');
+        char* end = quotient.toChars(&digits[0], &digits[0] + width + 1).ptr;
+        size_t length = end - &digits[0];
+        std::memmove(&digits[0] + width - length, &digits[0], length);
+        std::fill(&digits[0], &digits[0] + width - length, '0');
+        digits.resize(width);
+        return;
+    }
+    std::vector<BigInteger::Limb> shifted(chunks, 0);
+    shifted.insert(shifted.end(), remainder.digits_.begin(), remainder.digits_.end());
+    remainder.assignLimbs(shifted.data(), shifted.size(), false);
+    divmod(remainder, denom, quotient, remainder);
+    digits.resize(width);
+    for (size_t i = 0; i < chunks; ++i) {
+        long long chunk = (i < quotient.digits_.size()) ? quotient.digits_[i] : 0;
+        for (size_t j = 0; j < 9; ++j) {
+            digits[width - 9 * i - j - 1] = static_cast<char>('0' + chunk % 10);
+            chunk /= 10;
+        }
+    }
+}
+
+// The remainder after d digits is first * 10^d mod denom. cycle recurs every cycle_digits
+// digits from cycle_start on, so the period divides cycle_digits and is found by dropping
+// prime factors; the start is the smallest d whose remainder comes back after one period.
+Rational::DecimalPeriod Rational::decimalPeriod(const BigInteger& first, const BigInteger& cycle,
+                                                size_t cycle_start, size_t cycle_digits,
+                                                const BigInteger& denom) {
+    BigIntegerModulus modulus(denom);
+    const BigInteger ten = 10;
+    auto shift = [&](const BigInteger& remainder, size_t digits) {
+        return modulus.multiply(remainder, modulus.pow(ten, BigInteger(static_cast<long long>(digits))));
+    };
+    DecimalPeriod period;
+    period.found = true;
+    period.length = cycle_digits;
+    size_t rest = cycle_digits;
+    for (size_t p = 2; rest > 1; ++p) {
+        if (p * p > rest) {
+            p = rest;
+        }
+        if (rest % p != 0) {
+            continue;
+        }
+        while (rest % p == 0) {
+            rest /= p;
+        }
+        while (period.length % p == 0 && shift(cycle, period.length / p) == cycle) {
+            period.length /= p;
+        }
+    }
+    BigInteger step = modulus.pow(ten, BigInteger(static_cast<long long>(period.length)));
+    size_t low = 0, high = cycle_start;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        BigInteger remainder = shift(first, middle);
+        if (modulus.multiply(remainder, step) == remainder) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    period.start = low;
+    return period;
+}
+
+// Denominators below kDecimalWordLimit_ divide digit by digit in a machine word, with
+// Brent's cycle search on the remainders giving the exact period.
+template <typename Sink>
+Rational::DecimalPeriod Rational::writeDecimalWord(unsigned long long remainder, unsigned long long denom,
+                                                   size_t precision, Sink& sink) {
+    const unsigned long long first = remainder;
+    unsigned long long tortoise = remainder;
+    size_t power = 1, lambda = 0;
+    DecimalPeriod period;
+    period.found = (remainder == 0);
+    char chunk[9];
+    size_t filled = 0;
+    for (size_t written = 0; written < precision; ++written) {
+        remainder *= 10;
+        unsigned long long digit = remainder / denom;
+        remainder -= digit * denom;
+        chunk[filled++] = static_cast<char>('0' + digit);
+        if (filled == 9 || written + 1 == precision) {
+            sink(chunk, filled);
+            filled = 0;
+        }
+        if (period.found) {
+            continue;
+        }
+        if (remainder == 0) {
+            period.found = true;
+            period.start = written + 1;
+            continue;
+        }
+        ++lambda;
+        if (remainder == tortoise) {
+            period.found = true;
+            period.length = lambda;
+            unsigned long long slow = first, fast = first;
+            for (size_t i = 0; i < lambda; ++i) {
+                fast = fast * 10 % denom;
+            }
+            while (slow != fast) {
+                slow = slow * 10 % denom;
+                fast = fast * 10 % denom;
+                ++period.start;
+            }
+        } else if (lambda == power) {
+            tortoise = remainder;
+            power *= 2;
+            lambda = 0;
+        }
+    }
+    return period;
+}
+
+// Long division in blocks of at least kDecimalBlockChunks_ 9-digit chunks, about as many as
+// the denominator has limbs, so each block is one balanced division and only the remainder
+// is kept between blocks. Brent's cycle search runs on the block remainders, so a period
+// is only noticed once it lines up with the block boundaries.
+template <typename Sink>
+Rational::DecimalPeriod Rational::writeDecimalBlocks(BigInteger& remainder, const BigInteger& denom,
+                                                     size_t precision, Sink& sink) {
+    size_t chunks = (BigInteger::kBinaryLimbs_ ? 3 : 1) * denom.digits_.size();
+    if (chunks < kDecimalBlockChunks_) {
+        chunks = kDecimalBlockChunks_;
+    }
+    BigInteger scale = 1;
+    if (BigInteger::kBinaryLimbs_) {
+        BigInteger base = 1000000000;
+        for (size_t e = chunks; e > 0; e >>= 1) {
+            if (e & 1) {
+                scale *= base;
+            }
+            if (e > 1) {
+                base *= base;
+            }
+        }
+    }
+    const BigInteger first = remainder;
+    BigInteger tortoise = remainder;
+    size_t tortoise_digits = 0, power = 1, lambda = 0;
+    DecimalPeriod period;
+    period.found = (remainder == 0);
+    std::string digits;
+    static const char kZeros[] = "000000000";
+    for (size_t written = 0; written < precision;) {
+        if (remainder == 0) {
+            size_t count = std::min<size_t>(9, precision - written);
+            sink(kZeros, count);
+            written += count;
+            continue;
+        }
+        decimalBlock(remainder, denom, scale, chunks, digits);
+        size_t count = std::min(digits.size(), precision - written);
+        for (size_t pos = 0; pos < count; pos += 9) {
+            sink(digits.data() + pos, std::min<size_t>(9, count - pos));
+        }
+        size_t block_start = written;
+        written += count;
+        if (period.found) {
+            continue;
+        }
+        if (remainder == 0) {
+            period.found = true;
+            period.start = block_start + digits.find_last_not_of('0') + 1;
+            continue;
+        }
+        ++lambda;
+        if (remainder == tortoise) {
+            period = decimalPeriod(first, tortoise, tortoise_digits, lambda * digits.size(), denom);
+        } else if (lambda == power) {
+            tortoise = remainder;
+            tortoise_digits = block_start + digits.size();
+            power *= 2;
+            lambda = 0;
+        }
+    }
+    return period;
+}
+
+template <typename Sink, typename>
+Rational::DecimalPeriod Rational::writeDecimal(size_t precision, Sink&& sink) const {
+    BigInteger small_numer, small_denom;
+    if (is_small_) {
+        small_numer = small_numer_;
+        small_denom = small_denom_;
     }
+    const BigInteger& numer = is_small_ ? small_numer : numer_;
+    const BigInteger& denom = is_small_ ? small_denom : denom_;
+    BigInteger integer, remainder;
+    divmod(numer, denom, integer, remainder);
+    std::string head = is_negative_ ? "-" : "";
+    head += integer.toString();
+    head += '.';
+    sink(head.data(), head.size());
+    unsigned __int128 word_denom, word_remainder;
+    if (BigInteger::toSmall(denom.digits_.data(), denom.digits_.size(), word_denom) &&
+        word_denom < kDecimalWordLimit_) {
+        BigInteger::toSmall(remainder.digits_.data(), remainder.digits_.size(), word_remainder);
+        return writeDecimalWord(static_cast<unsigned long long>(word_remainder),
+                                static_cast<unsigned long long>(word_denom), precision, sink);
+    }
+    return writeDecimalBlocks(remainder, denom, precision, sink);
+}
+
+Rational::DecimalPeriod Rational::writeDecimal(size_t precision, std::ostream& ostream) const {
+    return writeDecimal(precision, [&ostream](const char* chars, size_t length) {
+        ostream.write(chars, static_cast<std::streamsize>(length));
+    });
+}
+
+std::string Rational::asDecimal(size_t precision) const {
     std::string result;
-    if (is_negative_) {
-        result = "-";
-    }
-    std::string f = other.toString();
-    if (f.length() <= precision) {
-        result += "0.";
-        std::string sup(precision - f.length(), '0');
-        result += sup;
-        result += f;
-        return result;
+    writeDecimal(precision, [&result](const char* chars, size_t length) {
+        result.append(chars, length);
+    });
+    if (is_negative_ && result.find_first_not_of("-0.") == std::string::npos) {
+        result.erase(0, 1);
     }
-    result += other.toString();
-    std::string dot = ".";
-    result.insert(result.size() - precision, dot);
     return result;
 }
 
+template <typename Float>
+Float Rational::toFloating() const {
+    Float value;
+    if (is_small_) {
+        if (small_numer_ == 0) {
+            return 0;
+        }
+        value = BigInteger::roundQuotient<Float>(BigInteger(small_numer_), BigInteger(small_denom_));
+    } else {
+        if (numer_ == 0) {
+            return 0;
+        }
+        value = BigInteger::roundQuotient<Float>(numer_, denom_);
+    }
+    return is_negative_ ? -value : value;
+}
+
 Rational::operator double() const {
-    return std::stod(asDecimal(15));
+    if (is_small_ && small_numer_ < (1ll << 53) && small_denom_ < (1ll << 53)) {
+        double value = static_cast<double>(small_numer_) / static_cast<double>(small_denom_);
+        return is_negative_ ? -value : value;
+    }
+    return toFloating<double>();
+}
+
+Rational::operator long double() const {
+    return toFloating<long double>();
+}
+
+// Natural logarithm of a positive value from its two leading limbs.
+double Rational::logMagnitude(const BigInteger& value) {
+    const BigInteger::LimbVector& limbs = value.digits_;
+    size_t n = limbs.size();
+    double lead = static_cast<double>(limbs[n - 1]);
+    if (n == 1) {
+        return std::log(lead);
+    }
+    lead = lead * static_cast<double>(BigInteger::kBase_) + static_cast<double>(limbs[n - 2]);
+    return std::log(lead) + static_cast<double>(n - 2) * std::log(static_cast<double>(BigInteger::kBase_));
+}
+
+// Compares |a| with |b| for big representations. The logarithms, good to about 1e-9, settle
+// everything but near-ties, which are decided by cross-multiplication.
+int Rational::compareMagnitudes(const Rational& a, const Rational& b) {
+    bool a_zero = (a.numer_ == 0), b_zero = (b.numer_ == 0);
+    if (a_zero || b_zero) {
+        return static_cast<int>(!a_zero) - static_cast<int>(!b_zero);
+    }
+    double difference = (logMagnitude(a.numer_) - logMagnitude(a.denom_)) -
+                        (logMagnitude(b.numer_) - logMagnitude(b.denom_));
+    if (difference < -1e-6 || difference > 1e-6) {
+        return (difference < 0) ? -1 : 1;
+    }
+    BigInteger left = a.numer_ * b.denom_, right = b.numer_ * a.denom_;
+    return (left < right) ? -1 : (right < left) ? 1 : 0;
 }
 
 bool operator<(const Rational& a, const Rational& b) {
     if (a.is_negative() != b.is_negative()) {
         return (b.is_negative() < a.is_negative());
     }
-    if (a == b) {
-        return false;
+    if (a.is_small_ && b.is_small_) {
+        __int128 left = static_cast<__int128>(a.small_numer_) * b.small_denom_;
+        __int128 right = static_cast<__int128>(b.small_numer_) * a.small_denom_;
+        return a.is_negative_ ? (right < left) : (left < right);
+    }
+    if (a.is_small_ || b.is_small_) {
+        Rational x = a, y = b;
+        x.promote();
+        y.promote();
+        return x < y;
     }
-    bool res = (a.numer_ *  b.denom_ < a.denom_ * b.numer_);
-    return (a.is_negative_) ? !res : res;
+    int cmp = Rational::compareMagnitudes(a, b);
+    return a.is_negative_ ? (cmp > 0) : (cmp < 0);
 }
 
 bool operator<=(const Rational& a, const Rational& b) {
@@ -582,8 +4079,22 @@ bool operator>=(const Rational& a, const Rational& b) {
     return !(a < b);
 }
 
+// Reduced values are compared limb by limb: a reduced value that fits in long long is always
+// kept small, so a small and a big reduced value never agree.
 bool operator==(const Rational& a, const Rational& b) {
-    return (a.toString() == b.toString());
+    if (a.is_negative_ != b.is_negative_) {
+        return false;
+    }
+    if (a.is_small_ && b.is_small_) {
+        return a.small_numer_ == b.small_numer_ && a.small_denom_ == b.small_denom_;
+    }
+    if (a.is_reduced_ && b.is_reduced_) {
+        return a.is_small_ == b.is_small_ && a.numer_ == b.numer_ && a.denom_ == b.denom_;
+    }
+    Rational x = a, y = b;
+    x.promote();
+    y.promote();
+    return Rational::compareMagnitudes(x, y) == 0;
 }
 
 bool operator!=(const Rational& a, const Rational& b){
@@ -591,97 +4102,55 @@ bool operator!=(const Rational& a, const Rational& b){
 }
 
 Rational& Rational::operator+=(const Rational& other) {
-    if (*this == 0 || other == 0) {
-        *this = (*this == 0) ? other : *this;
-        return *this;
-    }
-    if ((is_negative_) && !(other.is_negative_)) {
-        is_negative_ = false;
-        Rational result = other - *this;
-        *this = result;
-        return *this;
-    }
-    if (!(is_negative_) && (other.is_negative_)) {
-        Rational result = other;
-        result.makeUnsigned();
-        *this -= result;
-        return *this;
+    if (!(is_small_ && other.is_small_ && smallAdd(other, false))) {
+        add(other, false);
     }
-    Rational support = other;
-    bool res_is_neg = false;
-    if (is_negative_ && support.is_negative_) {
-        res_is_neg = true;
-        makeUnsigned();
-        support.makeUnsigned();
-    }
-    numer_ = (numer_ * support.denom_ + support.numer_ * denom_);
-    denom_ *= support.denom_;
-    toReduce();
-    is_negative_ = res_is_neg;
     return *this;
 }
 
 Rational& Rational::operator-=(const Rational& other){
-    if (*this == 0 || other == 0) {
-        *this = (*this == 0) ? -other : *this;
-        return *this;
-    }
-    if ((is_negative_) && !(other.is_negative_)) {
-        is_negative_ = false;
-        Rational result = other + *this;
-        *this = result;
-        is_negative_ = true;
-        return *this;
-    }
-    if (!(is_negative_) && (other.is_negative_)) {
-        Rational result = other;
-        result.makeUnsigned();
-        *this += result;
-        return *this;
+    if (!(is_small_ && other.is_small_ && smallAdd(other, true))) {
+        add(other, true);
     }
-    Rational support = other;
-    bool res_is_neg = false;
-    if (is_negative_ && support.is_negative_) {
-        res_is_neg = true;
-        makeUnsigned();
-        support.makeUnsigned();
-    }
-    numer_ = (numer_ * support.denom_ - support.numer_ * denom_);
-    if (numer_ < 0) {
-        res_is_neg = !(res_is_neg);
-        numer_.makeUnsigned();
-    }
-    denom_ *= support.denom_;
-    toReduce();
-    is_negative_ = res_is_neg;
     return *this;
 }
 
 Rational& Rational::operator*=(const Rational& other){
-    if (*this == 0 || other == 0) {
-        *this = 0;
+    if (is_small_ && other.is_small_ &&
+        smallMultiply(other.small_numer_, other.small_denom_, other.is_negative_)) {
         return *this;
     }
-    Rational support = other;
-    bool res_is_neg = false;
-    if (((is_negative_) && !(other.is_negative_)) || (!(is_negative_) && (other.is_negative_))) {
-        res_is_neg = true;
-        makeUnsigned();
-        support.makeUnsigned();
-    }
-    denom_ *= support.denom_;
-    toReduce();
-    numer_ *= support.numer_;
-    toReduce();
-    is_negative_ = res_is_neg;
+    promote();
+    Rational promoted;
+    const Rational* source = &other;
+    if (other.is_small_) {
+        promoted = other;
+        promoted.promote();
+        source = &promoted;
+    }
+    bool negative = (is_negative_ != source->is_negative_);
+    if (lazy_limbs_ != 0 || !is_reduced_ || !source->is_reduced_) {
+        numer_ *= source->numer_;
+        denom_ *= source->denom_;
+        is_negative_ = (numer_ != 0) && negative;
+        normalize();
+        return *this;
+    }
+    // Cross-cancellation: for a/b and c/d in lowest terms, gcd(a, d) and gcd(c, b) are the
+    // only common factors of the product, so the intermediates never exceed the result.
+    BigInteger g1 = GCD(numer_, source->denom_), g2 = GCD(source->numer_, denom_);
+    BigInteger numer = (g1 == 1) ? numer_ : numer_ / g1;
+    numer *= (g2 == 1) ? source->numer_ : source->numer_ / g2;
+    BigInteger denom = (g2 == 1) ? denom_ : denom_ / g2;
+    denom *= (g1 == 1) ? source->denom_ : source->denom_ / g1;
+    setReduced(numer, denom, negative);
     return *this;
 }
 
 Rational& Rational::operator/=(const Rational& other){
     Rational support = other;
-    std::swap(support.numer_, support.denom_);
+    support.invert();
     *this *= support;
-    toReduce();
     return *this;
 }
 
@@ -705,3 +4174,126 @@ Rational operator/(const Rational& left, const Rational& other){
     value /= other;
     return value;
 }
+
+// Written reduced, as the serialized numerator (carrying the sign) and denominator. Reading
+// rejects a pair that is not in lowest terms: stored as if reduced, it would break equality,
+// ordering and hashing.
+size_t Rational::serializedSize() const {
+    if (!is_reduced_) {
+        Rational copy = *this;
+        copy.toReduce();
+        return copy.serializedSize();
+    }
+    return numerator().serializedSize() + denominator().serializedSize();
+}
+
+std::to_chars_result Rational::serialize(char* first, char* last) const {
+    if (!is_reduced_) {
+        Rational copy = *this;
+        copy.toReduce();
+        return copy.serialize(first, last);
+    }
+    std::to_chars_result result = numerator().serialize(first, last);
+    if (result.ec != std::errc()) {
+        return result;
+    }
+    return denominator().serialize(result.ptr, last);
+}
+
+std::from_chars_result Rational::deserialize(const char* first, const char* last) {
+    BigInteger numer, denom;
+    std::from_chars_result result = numer.deserialize(first, last);
+    if (result.ec != std::errc()) {
+        return result;
+    }
+    result = denom.deserialize(result.ptr, last);
+    if (result.ec != std::errc()) {
+        return result;
+    }
+    if (denom.is_negative() || denom == 0 || GCD(numer, denom) != 1) {
+        return {first, std::errc::invalid_argument};
+    }
+    bool negative = numer.is_negative();
+    is_small_ = false;
+    setReduced(numer, denom, negative);
+    return result;
+}
+
+// Batches: a header with the batch flag and the number of values, then the values. T is
+// BigInteger or Rational; deserializeBatch also accepts BigIntegerView to index a buffer
+// without copying any limbs.
+template <typename T>
+size_t serializedSize(const std::vector<T>& values) {
+    size_t size = BigInteger::kSerialHeader_;
+    for (const T& value : values) {
+        size += value.serializedSize();
+    }
+    return size;
+}
+
+template <typename T>
+std::to_chars_result serializeBatch(const std::vector<T>& values, char* first, char* last) {
+    if (static_cast<size_t>(last - first) < BigInteger::kSerialHeader_ ||
+        values.size() > BigInteger::kSerialMaxCount_) {
+        return {last, std::errc::value_too_large};
+    }
+    BigInteger::writeSerialHeader(first, BigInteger::kSerialBatch_, values.size());
+    std::to_chars_result result{first + BigInteger::kSerialHeader_, std::errc()};
+    for (const T& value : values) {
+        result = value.serialize(result.ptr, last);
+        if (result.ec != std::errc()) {
+            break;
+        }
+    }
+    return result;
+}
+
+// Every value takes at least a header and one padded limb word, which bounds the count a
+// buffer can hold before anything is allocated. values is only replaced when all of them parse.
+template <typename T>
+std::from_chars_result deserializeBatch(const char* first, const char* last, std::vector<T>& values) {
+    unsigned char flags;
+    size_t count;
+    if (static_cast<size_t>(last - first) < BigInteger::kSerialHeader_) {
+        return {first, std::errc::invalid_argument};
+    }
+    if (!BigInteger::readSerialHeader(first, flags, count) || (flags & BigInteger::kSerialBatch_) == 0) {
+        return {first, std::errc::not_supported};
+    }
+    if (count > (static_cast<size_t>(last - first) - BigInteger::kSerialHeader_) / (BigInteger::kSerialHeader_ + 8)) {
+        return {first, std::errc::invalid_argument};
+    }
+    std::vector<T> parsed(count);
+    std::from_chars_result result{first + BigInteger::kSerialHeader_, std::errc()};
+    for (T& value : parsed) {
+        result = value.deserialize(result.ptr, last);
+        if (result.ec != std::errc()) {
+            return result;
+        }
+    }
+    values.swap(parsed);
+    return result;
+}
+
+// Product of a range of BigIntegers (or of values convertible to one), multiplied as a
+// balanced tree: much faster than a running product for many factors, e.g. factorials or
+// binomial coefficients, and parallel over setThreadLimit threads.
+template <typename Iterator>
+BigInteger product(Iterator first, Iterator last) {
+    std::vector<BigInteger> values(first, last);
+    if (values.empty()) {
+        return 1;
+    }
+    std::vector<size_t> limbs(values.size() + 1, 0);
+    for (size_t i = 0; i < values.size(); ++i) {
+        limbs[i + 1] = limbs[i] + values[i].digits_.size();
+    }
+    BigInteger result;
+    BigInteger::productRange(values.data(), limbs.data(), 0, values.size(), result);
+    return result;
+}
+
+template <typename Range>
+BigInteger product(const Range& values) {
+    return product(std::begin(values), std::end(values));
+}
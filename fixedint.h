@@ -0,0 +1,504 @@
+#pragma once
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "biginteger.h"
+
+// Two's complement integer of Bits bits, stored in 64-bit words, least significant first.
+// Arithmetic wraps modulo 2^Bits like the built-in integer types. / and % truncate toward
+// zero, as BigInteger's do. Everything except the string, stream and BigInteger conversions
+// is constexpr. The word loops have a constant trip count and are unrolled; carries and
+// comparisons go through double-word arithmetic instead of branches.
+template <size_t Bits>
+class FixedInt {
+    static_assert(Bits > 0 && Bits % 64 == 0, "FixedInt: Bits must be a positive multiple of 64");
+
+private:
+    using Word = unsigned long long;
+    using DoubleWord = unsigned __int128;
+    static const size_t kWords_ = Bits / 64;
+    static constexpr Word kDecimalChunk_ = 10000000000000000000ull;
+    static const int kDigitLength_ = 19;
+
+    Word words_[kWords_] = {};
+
+    constexpr bool isNegative() const { return (words_[kWords_ - 1] >> 63) != 0; }
+    constexpr FixedInt magnitude() const { return isNegative() ? -*this : *this; }
+    constexpr Word mulSmall(Word factor, Word addend);
+    constexpr Word divSmall(Word divisor);
+    static constexpr bool lessUnsigned(const FixedInt& a, const FixedInt& b);
+    static constexpr void divmodUnsigned(const FixedInt& a, const FixedInt& b, FixedInt& quotient,
+                                         FixedInt& remainder);
+    static constexpr void divmod(const FixedInt& a, const FixedInt& b, FixedInt& quotient, FixedInt& remainder);
+
+public:
+    constexpr FixedInt() = default;
+    template <typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+    constexpr FixedInt(T value);
+    constexpr explicit FixedInt(const char* str);
+    explicit FixedInt(const BigInteger& value);
+
+    std::string toString() const;
+    constexpr bool is_negative() const { return isNegative(); }
+    constexpr const Word* data() const { return words_; }
+
+    constexpr FixedInt& operator+=(const FixedInt& other);
+    constexpr FixedInt& operator-=(const FixedInt& other);
+    constexpr FixedInt& operator*=(const FixedInt& other);
+    constexpr FixedInt& operator/=(const FixedInt& other);
+    constexpr FixedInt& operator%=(const FixedInt& other);
+
+    constexpr FixedInt& operator++() { return *this += 1; }
+    constexpr FixedInt operator++(int);
+    constexpr FixedInt& operator--() { return *this -= 1; }
+    constexpr FixedInt operator--(int);
+    constexpr FixedInt operator-() const { return ~*this + 1; }
+
+    constexpr FixedInt& operator<<=(size_t shift);
+    constexpr FixedInt& operator>>=(size_t shift);
+    constexpr FixedInt& operator&=(const FixedInt& other);
+    constexpr FixedInt& operator|=(const FixedInt& other);
+    constexpr FixedInt& operator^=(const FixedInt& other);
+    constexpr FixedInt operator~() const;
+
+    constexpr size_t bit_length() const;
+    constexpr bool test_bit(size_t index) const;
+    constexpr size_t popcount() const;
+
+    constexpr explicit operator bool() const { return *this != 0; }
+    explicit operator BigInteger() const;
+
+    friend constexpr FixedInt operator+(FixedInt left, const FixedInt& right) { return left += right; }
+    friend constexpr FixedInt operator-(FixedInt left, const FixedInt& right) { return left -= right; }
+    friend constexpr FixedInt operator*(FixedInt left, const FixedInt& right) { return left *= right; }
+    friend constexpr FixedInt operator/(FixedInt left, const FixedInt& right) { return left /= right; }
+    friend constexpr FixedInt operator%(FixedInt left, const FixedInt& right) { return left %= right; }
+    friend constexpr FixedInt operator&(FixedInt left, const FixedInt& right) { return left &= right; }
+    friend constexpr FixedInt operator|(FixedInt left, const FixedInt& right) { return left |= right; }
+    friend constexpr FixedInt operator^(FixedInt left, const FixedInt& right) { return left ^= right; }
+    friend constexpr FixedInt operator<<(FixedInt left, size_t shift) { return left <<= shift; }
+    friend constexpr FixedInt operator>>(FixedInt left, size_t shift) { return left >>= shift; }
+
+    friend constexpr bool operator==(const FixedInt& a, const FixedInt& b) {
+        Word difference = 0;
+#pragma GCC unroll 16
+        for (size_t i = 0; i < kWords_; ++i) {
+            difference |= a.words_[i] ^ b.words_[i];
+        }
+        return difference == 0;
+    }
+    friend constexpr bool operator!=(const FixedInt& a, const FixedInt& b) { return !(a == b); }
+    friend constexpr bool operator<(const FixedInt& a, const FixedInt& b) {
+        return lessUnsigned(a, b) != (a.isNegative() != b.isNegative());
+    }
+    friend constexpr bool operator>(const FixedInt& a, const FixedInt& b) { return b < a; }
+    friend constexpr bool operator<=(const FixedInt& a, const FixedInt& b) { return !(b < a); }
+    friend constexpr bool operator>=(const FixedInt& a, const FixedInt& b) { return !(a < b); }
+
+    friend std::ostream& operator<<(std::ostream& ostream, const FixedInt& number) {
+        return ostream << number.toString();
+    }
+    friend std::istream& operator>>(std::istream& istream, FixedInt& number) {
+        BigInteger value;
+        istream >> value;
+        number = FixedInt(value);
+        return istream;
+    }
+};
+
+// Sign-extends signed values.
+template <size_t Bits>
+template <typename T, typename>
+constexpr FixedInt<Bits>::FixedInt(T value) {
+    Word fill = 0;
+    if constexpr (std::is_signed<T>::value) {
+        fill = (value < 0) ? ~Word(0) : 0;
+    }
+    for (size_t i = 0; i < kWords_; ++i) {
+        words_[i] = fill;
+    }
+    words_[0] = static_cast<Word>(value);
+    if constexpr (sizeof(T) > sizeof(Word)) {
+        if (kWords_ > 1) {
+            words_[1] = static_cast<Word>(value >> 64);
+        }
+    }
+}
+
+// Decimal literal with an optional '-', so that constants can be written in constant
+// expressions: constexpr FixedInt<128> m("170141183460469231731687303715884105727").
+template <size_t Bits>
+constexpr FixedInt<Bits>::FixedInt(const char* str) {
+    bool negative = (*str == '-');
+    if (negative) {
+        ++str;
+    }
+    if (*str == '\0') {
+        throw std::invalid_argument("FixedInt: empty number");
+    }
+    for (; *str != '\0'; ++str) {
+        if (*str < '0' || *str > '9') {
+            throw std::invalid_argument("FixedInt: invalid digit");
+        }
+        if (mulSmall(10, static_cast<Word>(*str - '0')) != 0) {
+            throw std::out_of_range("FixedInt: value out of range");
+        }
+    }
+    if (isNegative() && !(negative && *this == -*this)) {
+        throw std::out_of_range("FixedInt: value out of range");
+    }
+    if (negative) {
+        *this = -*this;
+    }
+}
+
+template <size_t Bits>
+FixedInt<Bits>::FixedInt(const BigInteger& value) {
+    std::vector<BigInteger::Word> words;
+    value.toWords(words);
+    size_t n = words.size();
+    while (n > 1 && words[n - 1] == 0) {
+        --n;
+    }
+    if (n > kWords_) {
+        throw std::out_of_range("FixedInt: value out of range");
+    }
+    for (size_t i = 0; i < n; ++i) {
+        words_[i] = words[i];
+    }
+    if (isNegative() && !(value.is_negative() && *this == -*this)) {
+        throw std::out_of_range("FixedInt: value out of range");
+    }
+    if (value.is_negative()) {
+        *this = -*this;
+    }
+}
+
+template <size_t Bits>
+FixedInt<Bits>::operator BigInteger() const {
+    FixedInt absolute = magnitude();
+    BigInteger value;
+    value.assignWords(absolute.words_, kWords_, isNegative());
+    return value;
+}
+
+template <size_t Bits>
+std::string FixedInt<Bits>::toString() const {
+    FixedInt absolute = magnitude();
+    Word chunks[kWords_ * 64 / 63 + 1] = {};
+    size_t count = 0;
+    do {
+        chunks[count++] = absolute.divSmall(kDecimalChunk_);
+    } while (absolute != 0);
+    std::string result = isNegative() ? "-" : "";
+    result += std::to_string(chunks[count - 1]);
+    for (size_t i = count - 1; i-- > 0;) {
+        std::string chunk = std::to_string(chunks[i]);
+        result.append(kDigitLength_ - chunk.size(), '0');
+        result += chunk;
+    }
+    return result;
+}
+
+// Unsigned *this = *this * factor + addend; returns the word carried out.
+template <size_t Bits>
+constexpr typename FixedInt<Bits>::Word FixedInt<Bits>::mulSmall(Word factor, Word addend) {
+    Word carry = addend;
+#pragma GCC unroll 16
+    for (size_t i = 0; i < kWords_; ++i) {
+        DoubleWord cur = DoubleWord(words_[i]) * factor + carry;
+        words_[i] = static_cast<Word>(cur);
+        carry = static_cast<Word>(cur >> 64);
+    }
+    return carry;
+}
+
+// Unsigned *this /= divisor; returns the remainder.
+template <size_t Bits>
+constexpr typename FixedInt<Bits>::Word FixedInt<Bits>::divSmall(Word divisor) {
+    Word remainder = 0;
+#pragma GCC unroll 16
+    for (size_t j = 0; j < kWords_; ++j) {
+        size_t i = kWords_ - 1 - j;
+        DoubleWord cur = (DoubleWord(remainder) << 64) | words_[i];
+        words_[i] = static_cast<Word>(cur / divisor);
+        remainder = static_cast<Word>(cur % divisor);
+    }
+    return remainder;
+}
+
+// The borrow out of a - b.
+template <size_t Bits>
+constexpr bool FixedInt<Bits>::lessUnsigned(const FixedInt& a, const FixedInt& b) {
+    Word borrow = 0;
+#pragma GCC unroll 16
+    for (size_t i = 0; i < kWords_; ++i) {
+        DoubleWord difference = DoubleWord(a.words_[i]) - b.words_[i] - borrow;
+        borrow = static_cast<Word>(difference >> 64) & 1;
+    }
+    return borrow != 0;
+}
+
+// Single-word divisors divide word by word; wider ones use Knuth's algorithm D on words,
+// with both operands shifted so that the divisor's top bit is set.
+template <size_t Bits>
+constexpr void FixedInt<Bits>::divmodUnsigned(const FixedInt& a, const FixedInt& b, FixedInt& quotient,
+                                              FixedInt& remainder) {
+    size_t n = kWords_;
+    while (n > 0 && b.words_[n - 1] == 0) {
+        --n;
+    }
+    if (n == 0) {
+        throw std::domain_error("FixedInt division by zero");
+    }
+    if (n == 1) {
+        Word divisor = b.words_[0];
+        quotient = a;
+        remainder = quotient.divSmall(divisor);
+        return;
+    }
+    if (lessUnsigned(a, b)) {
+        remainder = a;
+        quotient = 0;
+        return;
+    }
+    size_t m = kWords_;
+    while (a.words_[m - 1] == 0) {
+        --m;
+    }
+    unsigned shift = static_cast<unsigned>(__builtin_clzll(b.words_[n - 1]));
+    Word u[kWords_ + 1] = {};
+    Word v[kWords_] = {};
+    for (size_t i = 0; i < n; ++i) {
+        v[i] = (b.words_[i] << shift) | ((shift != 0 && i > 0) ? b.words_[i - 1] >> (64 - shift) : 0);
+    }
+    for (size_t i = 0; i <= m; ++i) {
+        Word low = (i < m) ? a.words_[i] << shift : 0;
+        u[i] = low | ((shift != 0 && i > 0) ? a.words_[i - 1] >> (64 - shift) : 0);
+    }
+    quotient = 0;
+    for (size_t j = m - n + 1; j-- > 0;) {
+        DoubleWord top = (DoubleWord(u[j + n]) << 64) | u[j + n - 1];
+        DoubleWord q_hat = top / v[n - 1];
+        DoubleWord r_hat = top % v[n - 1];
+        while ((q_hat >> 64) != 0 || q_hat * v[n - 2] > ((r_hat << 64) | u[j + n - 2])) {
+            --q_hat;
+            r_hat += v[n - 1];
+            if ((r_hat >> 64) != 0) {
+                break;
+            }
+        }
+        Word carry = 0;
+        Word borrow = 0;
+        for (size_t i = 0; i < n; ++i) {
+            DoubleWord product = q_hat * v[i] + carry;
+            carry = static_cast<Word>(product >> 64);
+            DoubleWord difference = DoubleWord(u[i + j]) - static_cast<Word>(product) - borrow;
+            u[i + j] = static_cast<Word>(difference);
+            borrow = static_cast<Word>(difference >> 64) & 1;
+        }
+        DoubleWord difference = DoubleWord(u[j + n]) - carry - borrow;
+        u[j + n] = static_cast<Word>(difference);
+        if ((difference >> 64) != 0) {
+            --q_hat;
+            Word add_carry = 0;
+            for (size_t i = 0; i < n; ++i) {
+                DoubleWord sum = DoubleWord(u[i + j]) + v[i] + add_carry;
+                u[i + j] = static_cast<Word>(sum);
+                add_carry = static_cast<Word>(sum >> 64);
+            }
+            u[j + n] += add_carry;
+        }
+        quotient.words_[j] = static_cast<Word>(q_hat);
+    }
+    remainder = 0;
+    for (size_t i = 0; i < n; ++i) {
+        remainder.words_[i] = (u[i] >> shift) | ((shift != 0) ? u[i + 1] << (64 - shift) : 0);
+    }
+}
+
+// a and b may alias quotient or remainder.
+template <size_t Bits>
+constexpr void FixedInt<Bits>::divmod(const FixedInt& a, const FixedInt& b, FixedInt& quotient,
+                                      FixedInt& remainder) {
+    bool a_negative = a.isNegative();
+    bool b_negative = b.isNegative();
+    divmodUnsigned(a.magnitude(), b.magnitude(), quotient, remainder);
+    if (a_negative != b_negative) {
+        quotient = -quotient;
+    }
+    if (a_negative) {
+        remainder = -remainder;
+    }
+}
+
+template <size_t Bits>
+constexpr FixedInt<Bits>& FixedInt<Bits>::operator+=(const FixedInt& other) {
+    Word carry = 0;
+#pragma GCC unroll 16
+    for (size_t i = 0; i < kWords_; ++i) {
+        DoubleWord sum = DoubleWord(words_[i]) + other.words_[i] + carry;
+        words_[i] = static_cast<Word>(sum);
+        carry = static_cast<Word>(sum >> 64);
+    }
+    return *this;
+}
+
+template <size_t Bits>
+constexpr FixedInt<Bits>& FixedInt<Bits>::operator-=(const FixedInt& other) {
+    Word borrow = 0;
+#pragma GCC unroll 16
+    for (size_t i = 0; i < kWords_; ++i) {
+        DoubleWord difference = DoubleWord(words_[i]) - other.words_[i] - borrow;
+        words_[i] = static_cast<Word>(difference);
+        borrow = static_cast<Word>(difference >> 64) & 1;
+    }
+    return *this;
+}
+
+// Schoolbook product truncated to the low kWords_ words, which is also the two's
+// complement product of signed values.
+template <size_t Bits>
+constexpr FixedInt<Bits>& FixedInt<Bits>::operator*=(const FixedInt& other) {
+    FixedInt result;
+#pragma GCC unroll 16
+    for (size_t i = 0; i < kWords_; ++i) {
+        Word carry = 0;
+#pragma GCC unroll 16
+        for (size_t j = 0; i + j < kWords_; ++j) {
+            DoubleWord cur = DoubleWord(words_[i]) * other.words_[j] + result.words_[i + j] + carry;
+            result.words_[i + j] = static_cast<Word>(cur);
+            carry = static_cast<Word>(cur >> 64);
+        }
+    }
+    return *this = result;
+}
+
+template <size_t Bits>
+constexpr FixedInt<Bits>& FixedInt<Bits>::operator/=(const FixedInt& other) {
+    FixedInt remainder;
+    divmod(*this, other, *this, remainder);
+    return *this;
+}
+
+template <size_t Bits>
+constexpr FixedInt<Bits>& FixedInt<Bits>::operator%=(const FixedInt& other) {
+    FixedInt quotient;
+    divmod(*this, other, quotient, *this);
+    return *this;
+}
+
+template <size_t Bits>
+constexpr FixedInt<Bits> FixedInt<Bits>::operator++(int) {
+    FixedInt copy = *this;
+    ++*this;
+    return copy;
+}
+
+template <size_t Bits>
+constexpr FixedInt<Bits> FixedInt<Bits>::operator--(int) {
+    FixedInt copy = *this;
+    --*this;
+    return copy;
+}
+
+template <size_t Bits>
+constexpr FixedInt<Bits>& FixedInt<Bits>::operator<<=(size_t shift) {
+    size_t word_shift = shift / 64;
+    unsigned bit_shift = shift % 64;
+#pragma GCC unroll 16
+    for (size_t j = 0; j < kWords_; ++j) {
+        size_t i = kWords_ - 1 - j;
+        Word high = (i >= word_shift) ? words_[i - word_shift] << bit_shift : 0;
+        Word low = (bit_shift != 0 && i > word_shift) ? words_[i - word_shift - 1] >> (64 - bit_shift) : 0;
+        words_[i] = high | low;
+    }
+    return *this;
+}
+
+// Arithmetic shift: rounds toward negative infinity, like BigInteger's >>=.
+template <size_t Bits>
+constexpr FixedInt<Bits>& FixedInt<Bits>::operator>>=(size_t shift) {
+    Word fill = isNegative() ? ~Word(0) : 0;
+    size_t word_shift = shift / 64;
+    unsigned bit_shift = shift % 64;
+#pragma GCC unroll 16
+    for (size_t i = 0; i < kWords_; ++i) {
+        Word low = (i + word_shift < kWords_) ? words_[i + word_shift] >> bit_shift : fill;
+        Word high = (i + word_shift + 1 < kWords_) ? words_[i + word_shift + 1] : fill;
+        words_[i] = (bit_shift != 0 && i + word_shift < kWords_) ? low | (high << (64 - bit_shift)) : low;
+    }
+    return *this;
+}
+
+template <size_t Bits>
+constexpr FixedInt<Bits>& FixedInt<Bits>::operator&=(const FixedInt& other) {
+#pragma GCC unroll 16
+    for (size_t i = 0; i < kWords_; ++i) {
+        words_[i] &= other.words_[i];
+    }
+    return *this;
+}
+
+template <size_t Bits>
+constexpr FixedInt<Bits>& FixedInt<Bits>::operator|=(const FixedInt& other) {
+#pragma GCC unroll 16
+    for (size_t i = 0; i < kWords_; ++i) {
+        words_[i] |= other.words_[i];
+    }
+    return *this;
+}
+
+template <size_t Bits>
+constexpr FixedInt<Bits>& FixedInt<Bits>::operator^=(const FixedInt& other) {
+#pragma GCC unroll 16
+    for (size_t i = 0; i < kWords_; ++i) {
+        words_[i] ^= other.words_[i];
+    }
+    return *this;
+}
+
+template <size_t Bits>
+constexpr FixedInt<Bits> FixedInt<Bits>::operator~() const {
+    FixedInt result;
+#pragma GCC unroll 16
+    for (size_t i = 0; i < kWords_; ++i) {
+        result.words_[i] = ~words_[i];
+    }
+    return result;
+}
+
+// bit_length and popcount count |x|, test_bit reads the two's complement, as in BigInteger.
+template <size_t Bits>
+constexpr size_t FixedInt<Bits>::bit_length() const {
+    FixedInt absolute = magnitude();
+    for (size_t i = kWords_; i-- > 0;) {
+        if (absolute.words_[i] != 0) {
+            return i * 64 + 64 - static_cast<size_t>(__builtin_clzll(absolute.words_[i]));
+        }
+    }
+    return 0;
+}
+
+template <size_t Bits>
+constexpr bool FixedInt<Bits>::test_bit(size_t index) const {
+    if (index >= Bits) {
+        return isNegative();
+    }
+    return ((words_[index / 64] >> (index % 64)) & 1) != 0;
+}
+
+template <size_t Bits>
+constexpr size_t FixedInt<Bits>::popcount() const {
+    FixedInt absolute = magnitude();
+    size_t count = 0;
+#pragma GCC unroll 16
+    for (size_t i = 0; i < kWords_; ++i) {
+        count += static_cast<size_t>(__builtin_popcountll(absolute.words_[i]));
+    }
+    return count;
+}
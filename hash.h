@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+
+// Byte hash in the style of wyhash: words are mixed by folding their 128-bit product, and
+// inputs over 48 bytes run three independent lanes so that several multiplications are in
+// flight at once. Every output bit depends on every input bit, low ones included, which
+// matters because UnorderedMap reduces hashes modulo the table size.
+class ByteHash {
+private:
+    using Word = unsigned long long;
+
+    static constexpr Word kSecret_[4] = {0xa0761d6478bd642full, 0xe7037ed1a0b428dbull,
+                                         0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull};
+
+    static Word mix(Word a, Word b);
+    static Word read8(const unsigned char* p);
+    static Word read4(const unsigned char* p);
+
+public:
+    static Word hash(const void* data, size_t size, Word seed = 0);
+};
+
+ByteHash::Word ByteHash::mix(Word a, Word b) {
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    return static_cast<Word>(product) ^ static_cast<Word>(product >> 64);
+}
+
+ByteHash::Word ByteHash::read8(const unsigned char* p) {
+    Word value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+ByteHash::Word ByteHash::read4(const unsigned char* p) {
+    unsigned value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Up to 16 bytes are read as two possibly overlapping words; longer inputs go in 48-byte
+// blocks over three lanes, then 16-byte steps, and the last 16 bytes close the hash.
+ByteHash::Word ByteHash::hash(const void* data, size_t size, Word seed) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    seed ^= mix(seed ^ kSecret_[0], kSecret_[1]);
+    Word a = 0;
+    Word b = 0;
+    if (size <= 16) {
+        if (size >= 4) {
+            size_t middle = (size >> 3) << 2;
+            a = (read4(p) << 32) | read4(p + middle);
+            b = (read4(p + size - 4) << 32) | read4(p + size - 4 - middle);
+        } else if (size > 0) {
+            a = (Word(p[0]) << 16) | (Word(p[size >> 1]) << 8) | p[size - 1];
+        }
+    } else {
+        size_t left = size;
+        if (left > 48) {
+            Word lane1 = seed;
+            Word lane2 = seed;
+            do {
+                seed = mix(read8(p) ^ kSecret_[1], read8(p + 8) ^ seed);
+                lane1 = mix(read8(p + 16) ^ kSecret_[2], read8(p + 24) ^ lane1);
+                lane2 = mix(read8(p + 32) ^ kSecret_[3], read8(p + 40) ^ lane2);
+                p += 48;
+                left -= 48;
+            } while (left > 48);
+            seed ^= lane1 ^ lane2;
+        }
+        while (left > 16) {
+            seed = mix(read8(p) ^ kSecret_[1], read8(p + 8) ^ seed);
+            p += 16;
+            left -= 16;
+        }
+        a = read8(p + left - 16);
+        b = read8(p + left - 8);
+    }
+    unsigned __int128 product = static_cast<unsigned __int128>(a ^ kSecret_[1]) * (b ^ seed);
+    return mix(static_cast<Word>(product) ^ kSecret_[0] ^ size, static_cast<Word>(product >> 64) ^ kSecret_[1]);
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+#include "biginteger.h"
+
+// Dense matrix of Rationals, rows stored contiguously. Elimination clears each row's
+// denominators once and then runs fraction-free (Bareiss) elimination on BigIntegers, so
+// no GCD is taken per cell; only results are turned back into Rationals.
+class Matrix {
+private:
+    size_t rows_;
+    size_t cols_;
+    std::vector<Rational> data_;
+
+    static const size_t kParallelCells_ = 2048;
+
+    // Integer rows after clearing denominators: row i of the matrix equals
+    // cells[i * width, (i + 1) * width) divided by scale[i].
+    struct Elimination {
+        size_t rows;
+        size_t width;
+        std::vector<BigInteger> cells;
+        std::vector<BigInteger> scale;
+        std::vector<size_t> pivot_columns;
+        bool odd_swaps = false;
+    };
+
+    Elimination integerRows(const std::vector<Rational>* rhs) const;
+    static void eliminate(Elimination& e, size_t columns);
+    static void updateRows(Elimination& e, size_t pivot_row, size_t column, const BigInteger& previous,
+                           size_t first, size_t last);
+
+public:
+    Matrix(size_t rows, size_t cols);
+
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+    Rational& operator()(size_t row, size_t col) { return data_[row * cols_ + col]; }
+    const Rational& operator()(size_t row, size_t col) const { return data_[row * cols_ + col]; }
+
+    Rational det() const;
+    size_t rank() const;
+    std::vector<Rational> solve(const std::vector<Rational>& rhs) const;
+};
+
+Matrix::Matrix(size_t rows, size_t cols) : rows_(rows), cols_(cols), data_(rows * cols) {}
+
+// Each row, and its right-hand side entry when given, is multiplied by the lcm of its
+// denominators.
+Matrix::Elimination Matrix::integerRows(const std::vector<Rational>* rhs) const {
+    Elimination e;
+    e.rows = rows_;
+    e.width = cols_ + (rhs != nullptr ? 1 : 0);
+    e.cells.resize(e.rows * e.width);
+    e.scale.assign(e.rows, BigInteger(1));
+    for (size_t i = 0; i < rows_; ++i) {
+        const Rational* row = data_.data() + i * cols_;
+        BigInteger& lcm = e.scale[i];
+        for (size_t j = 0; j < e.width; ++j) {
+            BigInteger denom = (j < cols_) ? row[j].denominator() : (*rhs)[i].denominator();
+            if (denom != 1) {
+                lcm *= denom / GCD(lcm, denom);
+            }
+        }
+        for (size_t j = 0; j < e.width; ++j) {
+            const Rational& value = (j < cols_) ? row[j] : (*rhs)[i];
+            BigInteger denom = value.denominator();
+            BigInteger& cell = e.cells[i * e.width + j];
+            cell = value.numerator();
+            if (denom != lcm) {
+                cell *= lcm / denom;
+            }
+        }
+    }
+    return e;
+}
+
+// For rows [first, last) below the pivot: a[i][j] = (p * a[i][j] - a[i][c] * a[r][j]) / previous,
+// where p = a[r][c] is the pivot and previous the pivot of the step before. The division is
+// exact.
+void Matrix::updateRows(Elimination& e, size_t pivot_row, size_t column, const BigInteger& previous,
+                        size_t first, size_t last) {
+    const BigInteger* pivot = e.cells.data() + pivot_row * e.width;
+    BigInteger product;
+    for (size_t i = first; i < last; ++i) {
+        BigInteger* row = e.cells.data() + i * e.width;
+        BigInteger lead = row[column];
+        row[column] = 0;
+        for (size_t j = column + 1; j < e.width; ++j) {
+            row[j] *= pivot[column];
+            if (lead != 0 && pivot[j] != 0) {
+                product = lead * pivot[j];
+                row[j] -= product;
+            }
+            if (previous != 1) {
+                row[j] /= previous;
+            }
+        }
+    }
+}
+
+// Fraction-free row echelon form over the first columns columns; columns without a pivot
+// are skipped, which keeps every division exact. Row updates of one step are split across
+// threads once there are enough cells to pay for them; the threads come from BigInteger's
+// pool, so setThreadLimit caps them together with those of the multiplications inside.
+void Matrix::eliminate(Elimination& e, size_t columns) {
+    BigInteger previous = 1;
+    size_t threads = BigInteger::threadPool().limit.load();
+    size_t row = 0;
+    for (size_t column = 0; column < columns && row < e.rows; ++column) {
+        size_t pivot = row;
+        while (pivot < e.rows && e.cells[pivot * e.width + column] == 0) {
+            ++pivot;
+        }
+        if (pivot == e.rows) {
+            continue;
+        }
+        if (pivot != row) {
+            std::swap_ranges(e.cells.begin() + pivot * e.width, e.cells.begin() + (pivot + 1) * e.width,
+                             e.cells.begin() + row * e.width);
+            std::swap(e.scale[pivot], e.scale[row]);
+            e.odd_swaps = !e.odd_swaps;
+        }
+        size_t first = row + 1;
+        size_t count = e.rows - first;
+        size_t workers = std::min(threads, count * (e.width - column) / kParallelCells_);
+        if (workers <= 1) {
+            updateRows(e, row, column, previous, first, e.rows);
+        } else {
+            std::vector<std::function<void()>> tasks;
+            for (size_t t = 0; t < workers; ++t) {
+                tasks.emplace_back([&e, row, column, &previous, from = first + count * t / workers,
+                                    to = first + count * (t + 1) / workers] {
+                    updateRows(e, row, column, previous, from, to);
+                });
+            }
+            BigInteger::runParallel(tasks.data(), tasks.size());
+        }
+        previous = e.cells[row * e.width + column];
+        e.pivot_columns.push_back(column);
+        ++row;
+    }
+}
+
+// The last Bareiss pivot of a full-rank square matrix is its determinant.
+Rational Matrix::det() const {
+    if (rows_ != cols_) {
+        throw std::invalid_argument("Matrix: determinant of a non-square matrix");
+    }
+    if (rows_ == 0) {
+        return Rational(1);
+    }
+    Elimination e = integerRows(nullptr);
+    eliminate(e, cols_);
+    if (e.pivot_columns.size() < rows_) {
+        return Rational(0);
+    }
+    BigInteger scale = 1;
+    for (const BigInteger& factor : e.scale) {
+        scale *= factor;
+    }
+    Rational result = Rational(e.cells.back()) / Rational(scale);
+    return e.odd_swaps ? -result : result;
+}
+
+size_t Matrix::rank() const {
+    Elimination e = integerRows(nullptr);
+    eliminate(e, cols_);
+    return e.pivot_columns.size();
+}
+
+// Solves A x = rhs for square non-singular A. With d the determinant of the eliminated
+// integer matrix, y = d x is integral (Cramer), so back substitution runs on integers with
+// exact divisions and each x_i = y_i / d is reduced once.
+std::vector<Rational> Matrix::solve(const std::vector<Rational>& rhs) const {
+    if (rows_ != cols_ || rhs.size() != rows_) {
+        throw std::invalid_argument("Matrix: solve needs a square matrix and a matching right-hand side");
+    }
+    size_t n = rows_;
+    Elimination e = integerRows(&rhs);
+    eliminate(e, n);
+    if (e.pivot_columns.size() < n) {
+        throw std::domain_error("Matrix: singular system");
+    }
+    const BigInteger& d = e.cells[(n - 1) * e.width + (n - 1)];
+    std::vector<BigInteger> y(n);
+    for (size_t i = n; i-- > 0;) {
+        const BigInteger* row = e.cells.data() + i * e.width;
+        BigInteger sum = d * row[n];
+        for (size_t j = i + 1; j < n; ++j) {
+            if (row[j] != 0) {
+                sum -= row[j] * y[j];
+            }
+        }
+        y[i] = sum / row[i];
+    }
+    std::vector<Rational> x(n);
+    Rational denom(d);
+    for (size_t i = 0; i < n; ++i) {
+        x[i] = Rational(y[i]) / denom;
+    }
+    return x;
+}
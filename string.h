@@ -1,7 +1,10 @@
 #include <algorithm>
 #include <cstring>
+#include <functional>
 #include <iostream>
 
+#include "hash.h"
+
 class String {
 private:
     size_t size_;
@@ -53,6 +56,7 @@ public:
     bool empty() const { return (size_ == 0); }
     void clear() { size_ = 0; }
     const char* data() const { return string_; }
+    size_t hash() const { return ByteHash::hash(string_, size_); }
     char* data() { return string_; }
     void shrink_to_fit() { realloc(size() + 1); }
 };
@@ -71,7 +75,12 @@ String operator+(const String& lhs, char rhs);
 std::ostream& operator<<(std::ostream& os, const String& other);
 std::istream& operator>>(std::istream& is, String& other);
 
-String::String() : size_(0), capacity_(1), string_(nullptr) {}
+template <>
+struct std::hash<String> {
+    size_t operator()(const String& value) const { return value.hash(); }
+};
+
+String::String() : size_(0), capacity_(1), string_(new char[1]{}) {}
 
 String::String(const char* c_string)
         : size_(strlen(c_string)),
@@ -93,7 +102,8 @@ String::String(const String& other)
         : size_(other.size_),
           capacity_(other.capacity_),
           string_(new char[capacity_]) {
-    strcpy(string_, other.string_);
+    memcpy(string_, other.string_, size_);
+    string_[size_] = '\0';
 }
 
 String::~String() { delete[] string_; }
@@ -104,7 +114,8 @@ String& String::operator=(String other) {
 }
 
 bool operator<(const String& a, const String& b) {
-    return (memcmp(a.data(), b.data(), std::max(a.size(), b.size())) == -1);
+    int cmp = memcmp(a.data(), b.data(), std::min(a.size(), b.size()));
+    return (cmp < 0 || (cmp == 0 && a.size() < b.size()));
 }
 
 bool operator>(const String& a, const String& b) { return (b < a); }
@@ -114,7 +125,7 @@ bool operator<=(const String& a, const String& b) { return !(b < a); }
 bool operator>=(const String& a, const String& b) { return !(a < b); }
 
 bool operator==(const String& a, const String& b) {
-    return (memcmp(a.data(), b.data(), std::max(a.size(), b.size())) == 0);
+    return (a.size() == b.size() && memcmp(a.data(), b.data(), a.size()) == 0);
 }
 
 bool operator!=(const String& a, const String& b) { return !(a == b); }
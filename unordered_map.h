@@ -1,6 +1,13 @@
+#include <cstring>
+#include <functional>
 #include <memory>
+#include <stdexcept>
+#include <tuple>
 #include <vector>
 #include <iterator>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 template <typename T, typename A = std::allocator<T>>
 class List {
@@ -287,12 +294,49 @@ class List {
   }
 };
 
+// Storage policies for UnorderedMap. NodeBackend keeps elements in a linked list indexed by
+// a vector of list iterators: iterators and references survive rehashing. FlatBackend
+// keeps them in one contiguous slot array probed through a byte of hash metadata per slot,
+// which makes lookups much cheaper but moves elements when the table grows.
+struct NodeBackend {};
+struct FlatBackend {};
+
+// Hash functions such as std::hash<long long> are the identity; two rounds of folding a
+// 128-bit product spread every input bit over the bits both backends index with. One round
+// leaves arithmetic progressions of keys clustered in the low bits.
+size_t spread_hash(size_t hash) {
+  unsigned __int128 product = static_cast<unsigned __int128>(hash ^ 0x243f6a8885a308d3ull) * 0x9e3779b97f4a7c15ull;
+  hash = static_cast<size_t>(product) ^ static_cast<size_t>(product >> 64);
+  product = static_cast<unsigned __int128>(hash) * 0xbf58476d1ce4e5b9ull;
+  return static_cast<size_t>(product) ^ static_cast<size_t>(product >> 64);
+}
+
+// Probe lengths of a table's elements, as returned by UnorderedMap::probe_stats():
+// histogram[d] elements are found d probe steps past their first one.
+struct ProbeStats {
+  size_t elements = 0;
+  size_t max_probe_length = 0;
+  double mean_probe_length = 0;
+  std::vector<size_t> histogram;
+
+  void add(size_t length) {
+    if (histogram.size() <= length) {
+      histogram.resize(length + 1, 0);
+    }
+    ++histogram[length];
+    ++elements;
+    max_probe_length = std::max(max_probe_length, length);
+    mean_probe_length += (static_cast<double>(length) - mean_probe_length) / elements;
+  }
+};
+
 template<
         typename Key,
         typename Value,
         typename Hash = std::hash<Key>,
         typename Equal = std::equal_to<Key>,
-        typename Alloc = std::allocator<std::pair<const Key, Value>>
+        typename Alloc = std::allocator<std::pair<const Key, Value>>,
+        typename Backend = NodeBackend
 >
 class UnorderedMap {
  private:
@@ -301,52 +345,82 @@ class UnorderedMap {
   using ListType = List<NodeType, typename AllocTraits::template rebind_alloc<NodeType>>;
   using ListIterator = typename ListType::iterator;
   using ListConstIterator = typename ListType::const_iterator;
-  using ListIteratorAlloc = typename AllocTraits::template rebind_alloc<ListIterator>;
   using iterator = typename ListType::template Iterator<false>;
   using const_iterator = typename ListType::template Iterator<true>;
 
+  // An element of list_ and its spread hash; a null iter marks an empty bucket.
+  struct Bucket {
+    ListIterator iter = ListIterator(nullptr);
+    size_t hash = 0;
+  };
+
+  using BucketAlloc = typename AllocTraits::template rebind_alloc<Bucket>;
+
   static constexpr size_t START_BUCKET_COUNT = 64;
-  static constexpr size_t MAX_SEARCH_DIST = 16;
-  static constexpr float DEFAULT_MAX_LOAD_FACTOR = 0.8f;
+  static constexpr float DEFAULT_MAX_LOAD_FACTOR = 0.9f;
 
   Hash hash_;
   Equal equal_;
   Alloc alloc_;
-  std::vector<ListIterator, ListIteratorAlloc> hash_table_;
+  std::vector<Bucket, BucketAlloc> hash_table_;
   ListType list_;
 
-  void rehash() {
-    bool tmp = true;
-    const size_t count = hash_table_.size();
-    hash_table_.assign(count, nullptr);
-    for (auto iter = list_.begin(); iter != list_.end(); ++iter) {
-      const size_t hash_id = hash_(iter->first) % count;
-      const size_t end = std::min(count, hash_id + MAX_SEARCH_DIST);
-      for (size_t i = hash_id; i < end; ++i) {
-        if (!hash_table_[i % count]) {
-          hash_table_[i % count] = iter;
-          break;
-        } else if (i == end - 1) {
-          tmp = false;
-        }
+  // The bucket count is a power of two.
+  size_t mask() const { return hash_table_.size() - 1; }
+
+  size_t home(size_t hash) const { return hash & mask(); }
+
+  // How far the bucket at index is from its element's home bucket.
+  size_t distance(size_t index) const {
+    return (index - home(hash_table_[index].hash)) & mask();
+  }
+
+  // Robin Hood insertion: walking from its home, the new entry takes the place of the first
+  // entry that is closer to its own home and carries that one on. Probe lengths therefore
+  // stay short and even at high load factors.
+  void place(Bucket bucket) {
+    size_t index = home(bucket.hash);
+    for (size_t dist = 0;; ++dist) {
+      if (!hash_table_[index].iter) {
+        hash_table_[index] = bucket;
+        return;
       }
-      if (!tmp) {
-        break;
+      size_t resident = distance(index);
+      if (resident < dist) {
+        std::swap(bucket, hash_table_[index]);
+        dist = resident;
       }
+      index = (index + 1) & mask();
     }
-    if (!tmp) {
-      hash_table_.assign(count, nullptr);
-      for (auto iter = list_.begin(); iter != list_.end(); ++iter) {
-        const size_t hash_id = hash_(iter->first) % count;
-        if (!hash_table_[hash_id]) {
-          hash_table_[hash_id] = iter;
-        } else {
-          const size_t end = std::min(count, hash_id + MAX_SEARCH_DIST);
-          size_t i;
-          for (i = hash_id + 1; i < end && hash_table_[i % count]; ++i) {}
-          hash_table_[i % count] = iter;
+  }
+
+  // Bucket index of key, or hash_table_.size() when it is absent. The probe stops at an
+  // empty bucket or at an entry closer to its home than key would be: Robin Hood insertion
+  // would have put key before it. Stored hashes are compared before touching the node.
+  size_t find_index(const Key& key, size_t hash) const {
+    size_t index = home(hash);
+    for (size_t dist = 0;; ++dist) {
+      const Bucket& bucket = hash_table_[index];
+      if (!bucket.iter || distance(index) < dist) {
+        return hash_table_.size();
+      }
+      if (bucket.hash == hash) {
+        ListIterator iter = bucket.iter;
+        if (equal_(key, iter->first)) {
+          return index;
         }
       }
+      index = (index + 1) & mask();
+    }
+  }
+
+  void rehash(size_t count) {
+    std::vector<Bucket, BucketAlloc> old(count, Bucket(), hash_table_.get_allocator());
+    hash_table_.swap(old);
+    for (const Bucket& bucket : old) {
+      if (bucket.iter) {
+        place(bucket);
+      }
     }
   }
 
@@ -354,8 +428,8 @@ class UnorderedMap {
     return static_cast<float>(list_.size()) / hash_table_.size();
   }
 
-  void swap(const UnorderedMap& other) {
-    std::swap(hash_table_, other.hash_table);
+  void swap(UnorderedMap& other) {
+    std::swap(hash_table_, other.hash_table_);
     std::swap(list_, other.list_);
     std::swap(hash_, other.hash_);
     std::swap(equal_, other.equal_);
@@ -372,19 +446,23 @@ class UnorderedMap {
   }
 
   UnorderedMap(const UnorderedMap& other) :
+          hash_(other.hash_),
+          equal_(other.equal_),
           alloc_(AllocTraits::select_on_container_copy_construction(other.alloc_)),
-          hash_table_(alloc_),
+          hash_table_(other.hash_table_.size(), Bucket(), alloc_),
           list_(other.list_) {
-    reserve(other.hash_table_.size());
-    rehash();
+    for (auto iter = list_.begin(); iter != list_.end(); ++iter) {
+      place(Bucket{iter, spread_hash(hash_(iter->first))});
+    }
   }
 
   UnorderedMap(UnorderedMap&& other) :
+          hash_(std::move(other.hash_)),
+          equal_(std::move(other.equal_)),
           alloc_(std::move(other.alloc_)),
           hash_table_(std::move(other.hash_table_)),
           list_(std::move(other.list_)) {
-    reserve(other.hash_table_.size());
-    rehash();
+    other.hash_table_.assign(START_BUCKET_COUNT, Bucket());
   }
 
   UnorderedMap& operator=(const UnorderedMap& other) {
@@ -402,6 +480,7 @@ class UnorderedMap {
       hash_ = std::move(other.hash_);
       equal_ = std::move(other.equal_);
       alloc_ = std::move(other.alloc_);
+      other.hash_table_.assign(START_BUCKET_COUNT, Bucket());
     }
     return *this;
   }
@@ -418,58 +497,48 @@ class UnorderedMap {
 
   const_iterator cend() const { return list_.cend(); }
 
+  // Rounds n up to a power of two.
   void reserve(size_t n) {
     if (n > hash_table_.size()) {
-      hash_table_.resize(n);
-      rehash();
+      size_t count = 1;
+      while (count < n) {
+        count *= 2;
+      }
+      rehash(count);
     }
   }
 
-  iterator find(const Key& key) {
-    size_t hash_id = hash_(key) % hash_table_.size();
-    size_t i = 0;
-    for (;;) {
-      const size_t index = (hash_id + i) % hash_table_.size();
-      if (!hash_table_[index]) {
-        return list_.end();
-      }
-      if (equal_(key, hash_table_[index]->first)) {
-        return hash_table_[index];
-      }
-      ++i;
-      if (i == MAX_SEARCH_DIST) {
-        return list_.end();
+  // Probe lengths, in buckets, of the stored elements: histogram[d] elements sit d buckets
+  // past their home bucket.
+  ProbeStats probe_stats() const {
+    ProbeStats stats;
+    for (size_t i = 0; i < hash_table_.size(); ++i) {
+      if (hash_table_[i].iter) {
+        stats.add(distance(i));
       }
     }
+    return stats;
+  }
+
+  iterator find(const Key& key) {
+    size_t index = find_index(key, spread_hash(hash_(key)));
+    return index == hash_table_.size() ? list_.end() : hash_table_[index].iter;
   }
 
   template <typename... Args>
   std::pair<iterator, bool> emplace(Args&&... args) {
     list_.emplace(list_.end(), std::forward<Args>(args)...);
     iterator element = --list_.end();
-    iterator iter = find(element->first);
-    if (iter != list_.end() && equal_(element->first, iter->first) && iter == element) {
-      return std::make_pair(iter, true);
-    } else if (iter != list_.end() && equal_(element->first, iter->first)) {
+    size_t hash = spread_hash(hash_(element->first));
+    size_t index = find_index(element->first, hash);
+    if (index != hash_table_.size()) {
       list_.pop_back();
-      return std::make_pair(iter, false);
-    }
-    while (true) {
-      size_t sz = hash_table_.size();
-      size_t hash_id = hash_(element->first) % sz;
-      size_t i;
-      const size_t end = std::min(sz, hash_id + MAX_SEARCH_DIST);
-      for (i = hash_id; i < end && hash_table_[i % sz]; ++i) {}
-      if (!hash_table_[i % sz]) {
-        hash_table_[i % sz] = element;
-        break;
-      } else {
-        reserve(sz * 2);
-      }
+      return std::make_pair(hash_table_[index].iter, false);
     }
     if (load_factor() > DEFAULT_MAX_LOAD_FACTOR) {
       reserve(hash_table_.size() * 2);
     }
+    place(Bucket{element, hash});
     return std::make_pair(element, true);
   }
 
@@ -478,9 +547,6 @@ class UnorderedMap {
   }
 
   void insert(NodeType&& node) {
-    if (load_factor() >= DEFAULT_MAX_LOAD_FACTOR) {
-      reserve(hash_table_.size() * 2);
-    }
     emplace(std::move(const_cast<Key&>(node.first)), std::move(node.second));
   }
 
@@ -492,14 +558,19 @@ class UnorderedMap {
     }
   }
 
+  // Backward-shift deletion: the entries after the erased one move back a bucket until an
+  // empty bucket or an entry already at its home, so no tombstones are left behind.
   void erase(iterator iter) {
-    size_t hash_id = hash_(iter->first) % hash_table_.size();
-    for (size_t i = 0; i < MAX_SEARCH_DIST; ++i) {
-      if (hash_table_[(hash_id + i) % hash_table_.size()] == iter) {
-        hash_table_[(hash_id + i) % hash_table_.size()] = iterator();
-        break;
-      }
+    size_t index = home(spread_hash(hash_(iter->first)));
+    while (hash_table_[index].iter != iter) {
+      index = (index + 1) & mask();
     }
+    for (size_t next = (index + 1) & mask(); hash_table_[next].iter && distance(next) > 0;
+         next = (next + 1) & mask()) {
+      hash_table_[index] = hash_table_[next];
+      index = next;
+    }
+    hash_table_[index] = Bucket();
     list_.erase(iter);
   }
 
@@ -535,3 +606,444 @@ class UnorderedMap {
     throw std::out_of_range("You have made some cringe!");
   }
 };
+
+// Swiss table: slots come in groups of GROUP_WIDTH, each slot with a control byte that is
+// EMPTY, DELETED or, for a full slot, the low 7 bits of its hash. A lookup scans a whole
+// group's control bytes at once (one SSE2 compare) and only compares keys whose fragment
+// matches; it stops at the first group with an EMPTY byte. Groups are probed triangularly,
+// which visits every group because their count is a power of two.
+template <typename Key, typename Value, typename Hash, typename Equal, typename Alloc>
+class UnorderedMap<Key, Value, Hash, Equal, Alloc, FlatBackend> {
+ private:
+  using NodeType = std::pair<const Key, Value>;
+  using AllocTraits = std::allocator_traits<Alloc>;
+  using SlotAlloc = typename AllocTraits::template rebind_alloc<NodeType>;
+  using SlotTraits = std::allocator_traits<SlotAlloc>;
+  using CtrlAlloc = typename AllocTraits::template rebind_alloc<unsigned char>;
+  using CtrlTraits = std::allocator_traits<CtrlAlloc>;
+
+  static constexpr size_t GROUP_WIDTH = 16;
+  static constexpr size_t START_GROUP_COUNT = 4;
+  static constexpr unsigned char EMPTY = 0x80;
+  static constexpr unsigned char DELETED = 0xFE;
+
+  // Bit masks over the GROUP_WIDTH control bytes starting at ctrl.
+  struct Group {
+#ifdef __SSE2__
+    __m128i ctrl;
+
+    explicit Group(const unsigned char* bytes)
+            : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes))) {}
+
+    unsigned match(unsigned char fragment) const {
+      return static_cast<unsigned>(
+              _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(static_cast<char>(fragment)), ctrl)));
+    }
+
+    // EMPTY and DELETED are the control bytes with the high bit set.
+    unsigned match_free() const {
+      return static_cast<unsigned>(_mm_movemask_epi8(ctrl));
+    }
+#else
+    const unsigned char* ctrl;
+
+    explicit Group(const unsigned char* bytes) : ctrl(bytes) {}
+
+    unsigned match(unsigned char fragment) const {
+      unsigned mask = 0;
+      for (size_t i = 0; i < GROUP_WIDTH; ++i) {
+        mask |= static_cast<unsigned>(ctrl[i] == fragment) << i;
+      }
+      return mask;
+    }
+
+    unsigned match_free() const {
+      unsigned mask = 0;
+      for (size_t i = 0; i < GROUP_WIDTH; ++i) {
+        mask |= static_cast<unsigned>(ctrl[i] >> 7) << i;
+      }
+      return mask;
+    }
+#endif
+
+    unsigned match_empty() const { return match(EMPTY); }
+  };
+
+  Hash hash_;
+  Equal equal_;
+  SlotAlloc alloc_;
+  unsigned char* ctrl_ = nullptr;
+  NodeType* slots_ = nullptr;
+  size_t group_count_ = 0;
+  size_t size_ = 0;
+  size_t growth_left_ = 0;
+
+  size_t capacity() const { return group_count_ * GROUP_WIDTH; }
+
+  // Tables stay at most 7/8 full, counting DELETED slots as full.
+  static size_t max_load(size_t capacity) { return capacity - capacity / 8; }
+
+  size_t hash_of(const Key& key) const { return spread_hash(hash_(key)); }
+
+  static unsigned char fragment(size_t hash) { return static_cast<unsigned char>(hash & 0x7F); }
+
+  // Slot index of key, or capacity() when it is absent.
+  size_t find_index(const Key& key, size_t hash) const {
+    const size_t group_mask = group_count_ - 1;
+    size_t group = (hash >> 7) & group_mask;
+    for (size_t step = 1;; ++step) {
+      Group g(ctrl_ + group * GROUP_WIDTH);
+      for (unsigned mask = g.match(fragment(hash)); mask != 0; mask &= mask - 1) {
+        size_t index = group * GROUP_WIDTH + static_cast<size_t>(__builtin_ctz(mask));
+        if (equal_(key, slots_[index].first)) {
+          return index;
+        }
+      }
+      if (g.match_empty() != 0) {
+        return capacity();
+      }
+      group = (group + step) & group_mask;
+    }
+  }
+
+  // First EMPTY or DELETED slot on the probe sequence of hash; one exists while the table
+  // respects max_load.
+  size_t find_free(size_t hash) const {
+    const size_t group_mask = group_count_ - 1;
+    size_t group = (hash >> 7) & group_mask;
+    for (size_t step = 1;; ++step) {
+      unsigned mask = Group(ctrl_ + group * GROUP_WIDTH).match_free();
+      if (mask != 0) {
+        return group * GROUP_WIDTH + static_cast<size_t>(__builtin_ctz(mask));
+      }
+      group = (group + step) & group_mask;
+    }
+  }
+
+  void allocate(size_t group_count) {
+    group_count_ = group_count;
+    CtrlAlloc ctrl_alloc = alloc_;
+    ctrl_ = CtrlTraits::allocate(ctrl_alloc, capacity());
+    std::memset(ctrl_, EMPTY, capacity());
+    slots_ = SlotTraits::allocate(alloc_, capacity());
+    growth_left_ = max_load(capacity());
+    size_ = 0;
+  }
+
+  void deallocate() {
+    if (ctrl_ == nullptr) {
+      return;
+    }
+    for (size_t i = 0; i < capacity(); ++i) {
+      if (ctrl_[i] < EMPTY) {
+        SlotTraits::destroy(alloc_, slots_ + i);
+      }
+    }
+    CtrlAlloc ctrl_alloc = alloc_;
+    CtrlTraits::deallocate(ctrl_alloc, ctrl_, capacity());
+    SlotTraits::deallocate(alloc_, slots_, capacity());
+    ctrl_ = nullptr;
+    slots_ = nullptr;
+  }
+
+  // Moves every element into a fresh table of group_count groups, which also drops all
+  // DELETED markers.
+  void rehash(size_t group_count) {
+    unsigned char* old_ctrl = ctrl_;
+    NodeType* old_slots = slots_;
+    const size_t old_capacity = capacity();
+    const size_t count = size_;
+    allocate(group_count);
+    for (size_t i = 0; i < old_capacity; ++i) {
+      if (old_ctrl[i] < EMPTY) {
+        NodeType& node = old_slots[i];
+        size_t hash = hash_of(node.first);
+        size_t index = find_free(hash);
+        SlotTraits::construct(alloc_, slots_ + index, std::move(const_cast<Key&>(node.first)),
+                              std::move(node.second));
+        ctrl_[index] = fragment(hash);
+        SlotTraits::destroy(alloc_, old_slots + i);
+      }
+    }
+    size_ = count;
+    growth_left_ -= count;
+    CtrlAlloc ctrl_alloc = alloc_;
+    CtrlTraits::deallocate(ctrl_alloc, old_ctrl, old_capacity);
+    SlotTraits::deallocate(alloc_, old_slots, old_capacity);
+  }
+
+  // Constructs a new element for a key known to be absent. Reusing a DELETED slot needs no
+  // room; taking an EMPTY one does, and without room the table doubles, or is only rebuilt
+  // when DELETED markers take up most of it.
+  template <typename... Args>
+  size_t insert_new(size_t hash, Args&&... args) {
+    size_t index = find_free(hash);
+    if (growth_left_ == 0 && ctrl_[index] == EMPTY) {
+      rehash(size_ * 2 >= max_load(capacity()) ? group_count_ * 2 : group_count_);
+      index = find_free(hash);
+    }
+    SlotTraits::construct(alloc_, slots_ + index, std::forward<Args>(args)...);
+    growth_left_ -= (ctrl_[index] == EMPTY);
+    ctrl_[index] = fragment(hash);
+    ++size_;
+    return index;
+  }
+
+  // key must stay valid until the element is constructed: it may be a reference into args.
+  template <typename... Args>
+  std::pair<size_t, bool> try_insert(const Key& key, Args&&... args) {
+    size_t hash = hash_of(key);
+    size_t index = find_index(key, hash);
+    if (index != capacity()) {
+      return std::make_pair(index, false);
+    }
+    return std::make_pair(insert_new(hash, std::forward<Args>(args)...), true);
+  }
+
+  void swap(UnorderedMap& other) {
+    std::swap(hash_, other.hash_);
+    std::swap(equal_, other.equal_);
+    std::swap(alloc_, other.alloc_);
+    std::swap(ctrl_, other.ctrl_);
+    std::swap(slots_, other.slots_);
+    std::swap(group_count_, other.group_count_);
+    std::swap(size_, other.size_);
+    std::swap(growth_left_, other.growth_left_);
+  }
+
+ public:
+  template <bool is_const>
+  struct Iterator {
+   private:
+    const unsigned char* ctrl_;
+    const unsigned char* ctrl_end_;
+    NodeType* slot_;
+
+    void skip_free() {
+      while (ctrl_ != ctrl_end_ && *ctrl_ >= EMPTY) {
+        ++ctrl_;
+        ++slot_;
+      }
+    }
+
+   public:
+    using value_type = std::conditional_t<is_const, const NodeType, NodeType>;
+    using reference = std::conditional_t<is_const, const NodeType&, NodeType&>;
+    using pointer = std::conditional_t<is_const, const NodeType*, NodeType*>;
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = long long;
+
+    Iterator() = default;
+
+    Iterator(const unsigned char* ctrl, const unsigned char* ctrl_end, NodeType* slot)
+            : ctrl_(ctrl), ctrl_end_(ctrl_end), slot_(slot) {
+      skip_free();
+    }
+
+    reference operator*() const { return *slot_; }
+
+    pointer operator->() const { return slot_; }
+
+    Iterator<is_const>& operator++() {
+      ++ctrl_;
+      ++slot_;
+      skip_free();
+      return *this;
+    }
+
+    Iterator<is_const> operator++(int) {
+      Iterator<is_const> tmp(*this);
+      ++(*this);
+      return tmp;
+    }
+
+    bool operator==(const Iterator& iter) const { return slot_ == iter.slot_; }
+
+    bool operator!=(const Iterator& iter) const { return slot_ != iter.slot_; }
+
+    operator Iterator<true>() const { return Iterator<true>(ctrl_, ctrl_end_, slot_); }
+
+    NodeType* get_slot_ptr() const { return slot_; }
+  };
+
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+ private:
+  iterator iterator_at(size_t index) {
+    return iterator(ctrl_ + index, ctrl_ + capacity(), slots_ + index);
+  }
+
+  const_iterator iterator_at(size_t index) const {
+    return const_iterator(ctrl_ + index, ctrl_ + capacity(), slots_ + index);
+  }
+
+ public:
+  size_t size() const { return size_; }
+
+  UnorderedMap() : alloc_(Alloc()) {
+    allocate(START_GROUP_COUNT);
+  }
+
+  UnorderedMap(const UnorderedMap& other) :
+          hash_(other.hash_),
+          equal_(other.equal_),
+          alloc_(AllocTraits::select_on_container_copy_construction(other.alloc_)) {
+    allocate(other.group_count_);
+    for (size_t i = 0; i < capacity(); ++i) {
+      if (other.ctrl_[i] < EMPTY) {
+        SlotTraits::construct(alloc_, slots_ + i, other.slots_[i]);
+      }
+      ctrl_[i] = other.ctrl_[i];
+    }
+    size_ = other.size_;
+    growth_left_ = other.growth_left_;
+  }
+
+  UnorderedMap(UnorderedMap&& other) : UnorderedMap() {
+    swap(other);
+  }
+
+  UnorderedMap& operator=(const UnorderedMap& other) {
+    if (this != &other) {
+      UnorderedMap tmp(other);
+      swap(tmp);
+    }
+    return *this;
+  }
+
+  UnorderedMap& operator=(UnorderedMap&& other) {
+    if (this != &other) {
+      swap(other);
+    }
+    return *this;
+  }
+
+  ~UnorderedMap() {
+    deallocate();
+  }
+
+  iterator begin() { return iterator_at(0); }
+
+  const_iterator begin() const { return cbegin(); }
+
+  const_iterator cbegin() const { return iterator_at(0); }
+
+  iterator end() { return iterator_at(capacity()); }
+
+  const_iterator end() const { return cend(); }
+
+  const_iterator cend() const { return iterator_at(capacity()); }
+
+  // Makes room for n elements without further rehashing.
+  void reserve(size_t n) {
+    size_t group_count = group_count_;
+    while (max_load(group_count * GROUP_WIDTH) < n) {
+      group_count *= 2;
+    }
+    if (group_count > group_count_) {
+      rehash(group_count);
+    }
+  }
+
+  // Probe lengths, in groups, of the stored elements.
+  ProbeStats probe_stats() const {
+    ProbeStats stats;
+    const size_t group_mask = group_count_ - 1;
+    for (size_t i = 0; i < capacity(); ++i) {
+      if (ctrl_[i] < EMPTY) {
+        size_t group = (hash_of(slots_[i].first) >> 7) & group_mask;
+        size_t length = 0;
+        for (size_t step = 1; group != i / GROUP_WIDTH; ++step) {
+          group = (group + step) & group_mask;
+          ++length;
+        }
+        stats.add(length);
+      }
+    }
+    return stats;
+  }
+
+  iterator find(const Key& key) {
+    return iterator_at(find_index(key, hash_of(key)));
+  }
+
+  const_iterator find(const Key& key) const {
+    return iterator_at(find_index(key, hash_of(key)));
+  }
+
+  // The element is built first to learn its key; if the key is new it is moved into its slot.
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(Args&&... args) {
+    alignas(NodeType) unsigned char buffer[sizeof(NodeType)];
+    NodeType* node = reinterpret_cast<NodeType*>(buffer);
+    SlotTraits::construct(alloc_, node, std::forward<Args>(args)...);
+    std::pair<size_t, bool> result;
+    try {
+      result = try_insert(node->first, std::move(const_cast<Key&>(node->first)), std::move(node->second));
+    } catch (...) {
+      SlotTraits::destroy(alloc_, node);
+      throw;
+    }
+    SlotTraits::destroy(alloc_, node);
+    return std::make_pair(iterator_at(result.first), result.second);
+  }
+
+  void insert(const NodeType& node) {
+    try_insert(node.first, node);
+  }
+
+  void insert(NodeType&& node) {
+    try_insert(node.first, std::move(const_cast<Key&>(node.first)), std::move(node.second));
+  }
+
+  template <typename InputIterator>
+  void insert(const InputIterator& first, const InputIterator& second) {
+    for (auto iter = first; iter != second; ++iter) {
+      insert(*iter);
+    }
+  }
+
+  // A slot whose group still has an EMPTY byte can become EMPTY again: no probe for another
+  // key ever went past that group. Otherwise it becomes DELETED, so such probes go on.
+  void erase(iterator iter) {
+    size_t index = static_cast<size_t>(iter.get_slot_ptr() - slots_);
+    Group g(ctrl_ + index / GROUP_WIDTH * GROUP_WIDTH);
+    if (g.match_empty() != 0) {
+      ctrl_[index] = EMPTY;
+      ++growth_left_;
+    } else {
+      ctrl_[index] = DELETED;
+    }
+    SlotTraits::destroy(alloc_, slots_ + index);
+    --size_;
+  }
+
+  void erase(const Key& key) {
+    iterator iter = find(key);
+    if (iter == end()) {
+      return;
+    }
+    erase(iter);
+  }
+
+  void erase(iterator first, iterator second) {
+    while (first != second) {
+      iterator iter = first++;
+      erase(iter);
+    }
+  }
+
+  Value& operator[](const Key& key) {
+    size_t index = try_insert(key, std::piecewise_construct, std::forward_as_tuple(key), std::tuple<>()).first;
+    return slots_[index].second;
+  }
+
+  Value& at(const Key& key) {
+    iterator iter = find(key);
+    if (iter != end()) {
+      return iter->second;
+    }
+    throw std::out_of_range("You have made some cringe!");
+  }
+};